@@ -20,51 +20,95 @@
 #define EIGENFACES_HPP_
 
 #include "opencv2/opencv.hpp"
+#include "image_list.hpp"
+#include "projection.hpp"
 #include <limits.h>
 #include <vector>
 
 using namespace std;
 using namespace cv;
 
+enum {
+	EIGENFACES_PCA = 0, // exact PCA with cv::PCA
+	EIGENFACES_RANDOMIZED_PCA = 1 // truncated PCA on float data, see RandomizedPCA
+};
+
+// With dtype = CV_32FC1 the model is computed on float data and stores the
+// mean, the eigenvectors and the projections as float, which halves their
+// memory; samples are projected and compared in float. The eigenvalues are
+// always CV_64FC1. The streaming compute and update/remove do their small
+// dense algebra in double and store the results as dtype.
 class Eigenfaces {
 private:
 	int _num_components;
 	double _threshold;
-	vector<Mat> _projections;
+	int _method;
+	int _dtype; // CV_32FC1 or CV_64FC1, type of the mean, eigenvectors and projections
+	int _num_samples; // number of samples the mean and eigenvalues describe
+	Mat _projections; // one projection per row
+	Mat _sqnorms; // squared norms of the projections, 1 x N
 	vector<int> _labels;
+	vector<bool> _members; // true for the projections of the samples the PCA describes
 	Mat _eigenvectors;
 	Mat _eigenvalues;
 	Mat _mean;
+	subspace::Projection _projection; // projects into _eigenvectors with mean*W precomputed
+
+	//! finds the nearest projection for every row of Q
+	void nearest(const Mat& Q, vector<int>& labels, vector<double>& distances) const;
 
 public:
 	Eigenfaces() :
 		_num_components(0),
-		_threshold(DBL_MAX) {};
+		_threshold(DBL_MAX),
+		_method(EIGENFACES_PCA),
+		_dtype(CV_64FC1),
+		_num_samples(0) {};
 
 	//! create empty eigenfaces with num_components
-	Eigenfaces(int num_components, double threshold = DBL_MAX) :
+	Eigenfaces(int num_components, double threshold = DBL_MAX, int method = EIGENFACES_PCA, int dtype = CV_64FC1) :
 		_num_components(num_components),
-		_threshold(threshold) {};
+		_threshold(threshold),
+		_method(method),
+		_dtype(dtype),
+		_num_samples(0) {};
 
 	//! compute num_component eigenfaces for given images in src and corresponding classes in labels
 	Eigenfaces(const vector<Mat>& src,
 			const vector<int>& labels,
 			int num_components = 0,
-			double threshold = DBL_MAX) :
+			double threshold = DBL_MAX,
+			int method = EIGENFACES_PCA,
+			int dtype = CV_64FC1) :
 			    _num_components(num_components),
-			    _threshold(threshold)
+			    _threshold(threshold),
+			    _method(method),
+			    _dtype(dtype),
+			    _num_samples(0)
 	{
 	 compute(src, labels);
 	}
 
-	//! computes a PCA for given data
+	//! computes a PCA for given data, with the method given as EIGENFACES_*
 	void compute(const vector<Mat>& src, const vector<int>& labels);
+	//! computes the exact PCA of the images in src, reading chunk_size images at a time
+	void compute(const ImageList& src, int chunk_size = 100);
+	//! adds samples with an incremental PCA, or only their projections if freeze_basis is set
+	void update(const vector<Mat>& src, const vector<int>& labels, bool freeze_basis = false);
+	//! removes all samples of a label and returns their number, the PCA is downdated by those it describes unless freeze_basis is set
+	int remove(int label, bool freeze_basis = false);
 	//! predicts the label for a given sample
 	int predict(const Mat& src);
 	//! predicts the label for a given sample and the confidence of this prediction
 	void predict(const Mat& src, int &label, double &confidence);
-	//! projects a sample
+	//! predicts the labels for many samples at once
+	vector<int> predict(const vector<Mat>& src);
+	//! predicts the labels and the confidences for many samples at once
+	void predict(const vector<Mat>& src, vector<int>& labels, vector<double>& confidences);
+	//! projects samples given by row
 	Mat project(const Mat& src);
+	//! projects samples given by row into dst, dst is reused if it has the right size and type
+	void project(const Mat& src, Mat& dst);
 	//! reconstructs a sample
 	Mat reconstruct(const Mat& src);
 	//! returns the eigenvectors of this PCA
@@ -73,6 +117,12 @@ public:
 	Mat eigenvalues() const { return _eigenvalues; }
 	//! returns the mean of this PCA
 	Mat mean() const { return _mean; }
+	//! returns the method used to compute the PCA
+	int method() const { return _method; }
+	//! returns the type of the mean, eigenvectors and projections
+	int dtype() const { return _dtype; }
+	//! returns the projections of the training samples, one per row
+	Mat projections() const { return _projections; }
 };
 
 #endif /* EIGENFACES_H_ */
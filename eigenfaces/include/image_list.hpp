@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012. Philipp Wagner <bytefish[at]gmx[dot]de>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+#ifndef IMAGE_LIST_HPP_
+#define IMAGE_LIST_HPP_
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+// A list of labeled images, read from a CSV file with lines of the form
+// /path/to/image.ext;label. Only the paths and labels are kept in memory,
+// the images are read from disk when they are asked for, so a model can be
+// trained in chunks on more images than fit into memory.
+class ImageList {
+private:
+	vector<string> _paths;
+	vector<int> _labels;
+
+public:
+	ImageList() {};
+
+	//! reads the list from a CSV file
+	ImageList(const string& filename) {
+		read(filename);
+	}
+
+	//! reads the list from a CSV file, appending to this list
+	void read(const string& filename);
+	//! appends an image
+	void push_back(const string& path, int label);
+	//! removes the last image
+	void pop_back();
+	//! returns the number of images
+	int size() const { return (int) _paths.size(); }
+	//! returns the path of image i
+	const string& path(int i) const { return _paths[i]; }
+	//! returns the label of image i
+	int label(int i) const { return _labels[i]; }
+	//! returns all labels
+	const vector<int>& labels() const { return _labels; }
+	//! reads image i as grayscale
+	Mat image(int i) const;
+	//! reads the images [first,last) into the rows of dst with type rtype
+	void rows(int first, int last, Mat& dst, int rtype) const;
+};
+
+#endif /* IMAGE_LIST_HPP_ */
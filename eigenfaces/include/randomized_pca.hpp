@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2012. Philipp Wagner <bytefish[at]gmx[dot]de>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+
+#ifndef RANDOMIZED_PCA_HPP_
+#define RANDOMIZED_PCA_HPP_
+
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Truncated PCA by a randomized SVD as described in:
+//
+//   N. Halko, P. G. Martinsson, and J. A. Tropp, "Finding structure with
+//   randomness: Probabilistic algorithms for constructing approximate
+//   matrix decompositions", SIAM Review, 53(2):217--288, 2011.
+//
+// Only the first num_components components are computed. The data is read
+// in blocks of rows, 2*iterations+3 times in total, and is never converted
+// or centered as a whole. Float data (CV_32FC1) is multiplied in float,
+// all sums are kept in double. The results have the layout of cv::PCA with
+// CV_PCA_DATA_AS_ROW: eigenvectors by row and eigenvalues of the covariance
+// matrix scaled by 1/n, both CV_64FC1. With a few iterations they match the
+// exact PCA for a decaying spectrum, more oversampling or iterations help
+// when the spectrum is flat.
+class RandomizedPCA {
+public:
+	RandomizedPCA() {}
+
+	//! computes the first num_components principal components of the rows of data
+	RandomizedPCA(const Mat& data, int num_components, int oversampling = 10, int iterations = 2) {
+		compute(data, num_components, oversampling, iterations);
+	}
+
+	//! computes the first num_components principal components of the rows of data
+	void compute(const Mat& data, int num_components, int oversampling = 10, int iterations = 2);
+
+	Mat mean; //!< 1 x d mean of the samples
+	Mat eigenvectors; //!< num_components x d, one eigenvector per row
+	Mat eigenvalues; //!< num_components x 1, in descending order
+};
+
+#endif /* RANDOMIZED_PCA_HPP_ */
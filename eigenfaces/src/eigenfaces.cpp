@@ -1,13 +1,32 @@
 #include "helper.hpp"
 #include "eigenfaces.hpp"
+#include "randomized_pca.hpp"
+
+// Squared norms of the rows of P as 1 x N CV_64FC1.
+static void squared_norms(const Mat& P, Mat& sqnorms) {
+    reduce(P.mul(P), sqnorms, 1, CV_REDUCE_SUM, CV_64F);
+    sqnorms = sqnorms.reshape(1, 1);
+}
+
+static void check_dtype(int dtype) {
+    if(dtype != CV_32FC1 && dtype != CV_64FC1) {
+        string error_message = format("Unsupported type %d, use CV_32FC1 or CV_64FC1.", dtype);
+        CV_Error(CV_StsBadArg, error_message);
+    }
+}
 
 void Eigenfaces::compute(const vector<Mat>& src, const vector<int>& labels) {
     if(src.size() == 0) {
         string error_message = format("Empty training data was given. You'll need more than one sample to learn a model.");
         CV_Error(CV_StsUnsupportedFormat, error_message);
     }
-    // observations in row
-    Mat data = asRowMatrix(src, CV_64FC1);
+    if(_method != EIGENFACES_PCA && _method != EIGENFACES_RANDOMIZED_PCA) {
+        string error_message = format("Unknown method %d, use EIGENFACES_PCA or EIGENFACES_RANDOMIZED_PCA.", _method);
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    check_dtype(_dtype);
+    // observations in row, the randomized PCA only needs them as float
+    Mat data = asRowMatrix(src, (_method == EIGENFACES_RANDOMIZED_PCA) ? CV_32FC1 : _dtype);
     // number of samples
     int n = data.rows;
     // dimensionality of data
@@ -20,20 +39,424 @@ void Eigenfaces::compute(const vector<Mat>& src, const vector<int>& labels) {
     // clip number of components to be valid
     if((_num_components <= 0) || (_num_components > n))
         _num_components = n;
-    // perform the PCA
-    PCA pca(data, Mat(), CV_PCA_DATA_AS_ROW, _num_components);
-    // copy the PCA results
-    _mean = pca.mean.reshape(1,1); // store the mean vector
-    _eigenvalues = pca.eigenvalues.clone(); // eigenvalues by row
-    _eigenvectors = transpose(pca.eigenvectors); // eigenvectors by column
+    // perform the PCA and copy the results
+    if(_method == EIGENFACES_RANDOMIZED_PCA) {
+        RandomizedPCA pca(data, _num_components);
+        pca.mean.convertTo(_mean, _dtype); // store the mean vector
+        _eigenvalues = pca.eigenvalues; // eigenvalues by row
+        transpose(pca.eigenvectors).convertTo(_eigenvectors, _dtype); // eigenvectors by column
+    } else {
+        // computed in the type of data
+        PCA pca(data, Mat(), CV_PCA_DATA_AS_ROW, _num_components);
+        _mean = pca.mean.reshape(1,1); // store the mean vector
+        pca.eigenvalues.convertTo(_eigenvalues, CV_64FC1); // eigenvalues by row
+        _eigenvectors = transpose(pca.eigenvectors); // eigenvectors by column
+    }
+    _projection.init(_eigenvectors, _mean);
     _labels = labels; // store labels for prediction
-    // save projections
-    for(int sampleIdx = 0; sampleIdx < data.rows; sampleIdx++) {
-        Mat p = project(data.row(sampleIdx).clone());
-        this->_projections.push_back(p);
+    _members.assign(n, true);
+    _num_samples = n;
+    // save projections, one per row; in blocks, so the data is never
+    // converted as a whole
+    _projections.create(n, _eigenvectors.cols, _eigenvectors.type());
+    int block = max(1, (1 << 20) / d);
+    for(int i0 = 0; i0 < n; i0 += block) {
+        int i1 = min(i0 + block, n);
+        Mat dst = _projections.rowRange(i0, i1);
+        _projection.project(data.rowRange(i0, i1), dst);
+    }
+    // and their squared norms for the nearest neighbor search
+    squared_norms(_projections, _sqnorms);
+}
+
+// Reads the images [first,last) of src as rows and subtracts the mean.
+static void centered_rows(const ImageList& src, int first, int last, const Mat& mean, Mat& dst) {
+    src.rows(first, last, dst, CV_64FC1);
+    if(dst.cols != mean.cols) {
+        string error_message = format("Wrong number of elements in the images [%d,%d), expected %d, but was %d. All images must be of equal size.", first, last, mean.cols, dst.cols);
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    for(int i = 0; i < dst.rows; i++) {
+        Mat r_i = dst.row(i);
+        subtract(r_i, mean, r_i);
+    }
+}
+
+// Streams over the images in chunks, so besides two chunks of images only
+// the mean, a min(n,d) x min(n,d) matrix and the results are in memory:
+//
+//  * d <= n: the covariance matrix (d x d) is accumulated in a single pass
+//    and its eigenvectors are the eigenfaces.
+//  * n < d: the Gram matrix Xc*Xc^T (n x n) is accumulated blockwise, which
+//    reads every chunk again for the chunks after it. Its eigenvectors u_i
+//    give the eigenfaces Xc^T*u_i, accumulated in one more pass.
+//
+// The eigenfaces are normalized and the eigenvalues scaled by 1/n, as
+// cv::PCA does, so the result matches compute(vector<Mat>, vector<int>)
+// with EIGENFACES_PCA.
+void Eigenfaces::compute(const ImageList& src, int chunk_size) {
+    int n = src.size();
+    if(n == 0) {
+        string error_message = format("Empty training data was given. You'll need more than one sample to learn a model.");
+        CV_Error(CV_StsUnsupportedFormat, error_message);
+    }
+    check_dtype(_dtype);
+    chunk_size = max(1, chunk_size);
+    // first pass, the mean
+    Mat X, Y, partial;
+    Mat sum;
+    for(int i0 = 0; i0 < n; i0 += chunk_size) {
+        src.rows(i0, min(i0 + chunk_size, n), X, CV_64FC1);
+        if(sum.empty())
+            sum = Mat::zeros(1, X.cols, CV_64FC1);
+        if(X.cols != sum.cols) {
+            string error_message = format("Wrong number of elements in the images [%d,%d), expected %d, but was %d. All images must be of equal size.", i0, min(i0 + chunk_size, n), sum.cols, X.cols);
+            CV_Error(CV_StsBadArg, error_message);
+        }
+        reduce(X, partial, 0, CV_REDUCE_SUM);
+        add(sum, partial, sum);
+    }
+    int d = sum.cols;
+    _mean = sum * (1.0 / n);
+    // clip number of components to be valid
+    if((_num_components <= 0) || (_num_components > min(n, d)))
+        _num_components = min(n, d);
+    Mat evals, evecs;
+    if(d <= n) {
+        // covariance matrix
+        Mat C = Mat::zeros(d, d, CV_64FC1);
+        for(int i0 = 0; i0 < n; i0 += chunk_size) {
+            centered_rows(src, i0, min(i0 + chunk_size, n), _mean, X);
+            gemm(X, X, 1.0, Mat(), 0.0, partial, GEMM_1_T);
+            add(C, partial, C);
+        }
+        eigen(C, evals, evecs);
+        _eigenvectors = transpose(evecs.rowRange(0, _num_components));
+    } else {
+        // Gram matrix, block (i,j) and its transpose (j,i) at once
+        Mat G(n, n, CV_64FC1);
+        for(int i0 = 0; i0 < n; i0 += chunk_size) {
+            int i1 = min(i0 + chunk_size, n);
+            centered_rows(src, i0, i1, _mean, X);
+            for(int j0 = i0; j0 < n; j0 += chunk_size) {
+                int j1 = min(j0 + chunk_size, n);
+                if(j0 != i0)
+                    centered_rows(src, j0, j1, _mean, Y);
+                gemm(X, (j0 == i0) ? X : Y, 1.0, Mat(), 0.0, partial, GEMM_2_T);
+                Mat Gij = G(Range(i0, i1), Range(j0, j1));
+                Mat Gji = G(Range(j0, j1), Range(i0, i1));
+                partial.copyTo(Gij);
+                transpose(partial).copyTo(Gji);
+            }
+        }
+        eigen(G, evals, evecs);
+        // eigenfaces Xc^T*U, one per column
+        Mat U = transpose(evecs.rowRange(0, _num_components));
+        _eigenvectors = Mat::zeros(d, _num_components, CV_64FC1);
+        for(int i0 = 0; i0 < n; i0 += chunk_size) {
+            int i1 = min(i0 + chunk_size, n);
+            centered_rows(src, i0, i1, _mean, X);
+            gemm(X, U.rowRange(i0, i1), 1.0, Mat(), 0.0, partial, GEMM_1_T);
+            add(_eigenvectors, partial, _eigenvectors);
+        }
+        for(int i = 0; i < _num_components; i++) {
+            Mat w = _eigenvectors.col(i);
+            normalize(w, w);
+        }
+    }
+    _eigenvalues = evals.rowRange(0, _num_components) * (1.0 / n);
+    _labels = src.labels();
+    _members.assign(n, true);
+    _num_samples = n;
+    _mean.convertTo(_mean, _dtype);
+    _eigenvectors.convertTo(_eigenvectors, _dtype);
+    _projection.init(_eigenvectors, _mean);
+    // last pass, the projections
+    _projections.create(n, _num_components, _dtype);
+    for(int i0 = 0; i0 < n; i0 += chunk_size) {
+        int i1 = min(i0 + chunk_size, n);
+        src.rows(i0, i1, X, CV_64FC1);
+        Mat dst = _projections.rowRange(i0, i1);
+        _projection.project(X, dst);
     }
+    squared_norms(_projections, _sqnorms);
 }
 
+// Incremental PCA as described in:
+//
+//   D. Ross, J. Lim, R.-S. Lin, and M.-H. Yang, "Incremental Learning for
+//   Robust Visual Tracking", IJCV, 77(1):125--141, 2008.
+//
+// The scatter matrix of the n samples so far is W*diag(s^2)*W^T with
+// s^2 = n*eigenvalues. The m new samples B add the scatter of
+//
+//   Bh = [B - 1*mean(B); sqrt(n*m/(n+m))*(mean(B) - mean)]
+//
+// whose rows are split into coordinates P in W and a residual with the
+// orthonormal basis Q. In the basis [W Q^T] the new scatter is the small
+// matrix diag(s^2,0) + C^T*C with C = [P R*Q^T], its eigenvectors E rotate
+// the basis. Only the new samples are projected; the gallery is known by
+// its coordinates p in W, so it is moved with p*E + (mean - mean')*W' at a
+// cost of K^2 per sample. Parts of the gallery outside of W are lost, as
+// in every truncated incremental PCA.
+void Eigenfaces::update(const vector<Mat>& src, const vector<int>& labels, bool freeze_basis) {
+    if(_projections.empty()) {
+        compute(src, labels);
+        return;
+    }
+    if(src.size() != labels.size()) {
+        string error_message = format("The number of samples (src) must equal the number of labels (labels). Was len(samples)=%d, len(labels)=%d.", src.size(), labels.size());
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    if(src.empty())
+        return;
+    // the update is computed in double, the model keeps its type
+    Mat data = asRowMatrix(src, CV_64FC1);
+    int d = _eigenvectors.rows;
+    if(data.cols != d) {
+        string error_message = format("Wrong input image size. Reason: Training and Test images must be of equal size! Expected an image with %d elements, but got %d.", d, data.cols);
+        CV_Error(CV_StsError, error_message);
+    }
+    if(!freeze_basis) {
+        int n = _num_samples;
+        int m = data.rows;
+        // components without variance may not be orthogonal to the others
+        // (cv::PCA normalizes whatever is left), so they are left out
+        int K = 1;
+        while(K < _eigenvectors.cols && _eigenvalues.at<double>(K) > _eigenvalues.at<double>(0) * DBL_EPSILON * d)
+            K++;
+        Mat W, mean, gallery;
+        _eigenvectors.colRange(0, K).convertTo(W, CV_64F);
+        _mean.convertTo(mean, CV_64F);
+        _projections.colRange(0, K).convertTo(gallery, CV_64F);
+        // the new samples about their mean and the shift of the mean
+        Mat meanB;
+        reduce(data, meanB, 0, CV_REDUCE_SUM);
+        meanB = meanB * (1.0 / m);
+        Mat Bh(m + 1, d, W.type());
+        for(int i = 0; i < m; i++) {
+            Mat r_i = Bh.row(i);
+            subtract(data.row(i), meanB, r_i);
+        }
+        Mat shift = Bh.row(m);
+        subtract(meanB, mean, shift);
+        shift.convertTo(shift, -1, std::sqrt((double) n * m / (n + m)));
+        // coordinates in W and the residual, orthogonalized twice
+        Mat P, P2, R1, R;
+        gemm(Bh, W, 1.0, Mat(), 0.0, P);
+        gemm(P, W, -1.0, Bh, 1.0, R1, GEMM_2_T);
+        gemm(R1, W, 1.0, Mat(), 0.0, P2);
+        gemm(P2, W, -1.0, R1, 1.0, R, GEMM_2_T);
+        add(P, P2, P);
+        // orthonormal basis Q of the residual, the rows of E_r*R scaled by
+        // 1/sqrt(l) for the eigenpairs (l, E_r) of R*R^T with weight
+        Mat RRt, rvals, rvecs;
+        mulTransposed(R, RRt, false);
+        eigen(RRt, rvals, rvecs);
+        double scale = std::max(rvals.at<double>(0), _eigenvalues.at<double>(0) * n);
+        int r = 0;
+        while(r < rvals.rows && rvals.at<double>(r) > scale * DBL_EPSILON * max(d, m + 1))
+            r++;
+        Mat Q(r, d, W.type());
+        for(int i = 0; i < r; i++) {
+            Mat q_i = Q.row(i);
+            gemm(rvecs.row(i), R, 1.0 / std::sqrt(rvals.at<double>(i)), Mat(), 0.0, q_i);
+        }
+        // scatter in the basis [W Q^T]
+        Mat C(m + 1, K + r, W.type());
+        Mat C_W = C.colRange(0, K);
+        P.copyTo(C_W);
+        if(r > 0) {
+            Mat C_Q = C.colRange(K, K + r);
+            gemm(R, Q, 1.0, Mat(), 0.0, C_Q, GEMM_2_T);
+        }
+        Mat M, evals, evecs;
+        mulTransposed(C, M, true);
+        for(int i = 0; i < K; i++)
+            M.at<double>(i, i) += _eigenvalues.at<double>(i) * n;
+        eigen(M, evals, evecs);
+        // rotate the basis
+        int num_components = min(_num_components, K + r);
+        Mat E = transpose(evecs.rowRange(0, num_components));
+        Mat E_W = E.rowRange(0, K);
+        Mat Wnew, W_Q;
+        gemm(W, E_W, 1.0, Mat(), 0.0, Wnew);
+        if(r > 0) {
+            gemm(Q, E.rowRange(K, K + r), 1.0, Mat(), 0.0, W_Q, GEMM_1_T);
+            add(Wnew, W_Q, Wnew);
+        }
+        Mat meanNew = (mean * n + meanB * m) * (1.0 / (n + m));
+        // move the gallery into the new basis
+        Mat offset, diff;
+        subtract(mean, meanNew, diff);
+        gemm(diff, Wnew, 1.0, Mat(), 0.0, offset);
+        Mat projections;
+        gemm(gallery, E_W, 1.0, Mat(), 0.0, projections);
+        for(int i = 0; i < projections.rows; i++) {
+            Mat p_i = projections.row(i);
+            add(p_i, offset, p_i);
+        }
+        Wnew.convertTo(_eigenvectors, _dtype);
+        _eigenvalues = evals.rowRange(0, num_components) * (1.0 / (n + m));
+        meanNew.convertTo(_mean, _dtype);
+        projections.convertTo(_projections, _dtype);
+        _num_samples = n + m;
+        _projection.init(_eigenvectors, _mean);
+    }
+    // project and append the new samples
+    _projections.push_back(project(data));
+    _labels.insert(_labels.end(), labels.begin(), labels.end());
+    _members.insert(_members.end(), labels.size(), !freeze_basis);
+    squared_norms(_projections, _sqnorms);
+}
+
+// Copies the rows of src given by indices.
+static Mat select_rows(const Mat& src, const vector<int>& indices) {
+    Mat dst((int) indices.size(), src.cols, src.type());
+    for(size_t i = 0; i < indices.size(); i++) {
+        Mat row = dst.row((int) i);
+        src.row(indices[i]).copyTo(row);
+    }
+    return dst;
+}
+
+// Removing samples is done in the coordinates p of the gallery only, so no
+// images are needed. Without the m samples B the scatter in W is
+//
+//   diag(s^2) - P_B^T*P_B - m^2/(n-m)*mean(P_B)^T*mean(P_B)
+//
+// and its eigenvectors E rotate the basis, the remaining projections move
+// with (p - delta)*E for the shift delta = -m/(n-m)*mean(P_B) of the mean.
+// Like the mean, the basis only changes within W. Only the removed samples
+// that are part of the PCA are downdated, samples added with a frozen basis
+// are just dropped from the gallery.
+int Eigenfaces::remove(int label, bool freeze_basis) {
+    vector<int> keep, removed, members;
+    for(size_t i = 0; i < _labels.size(); i++) {
+        if(_labels[i] != label) {
+            keep.push_back((int) i);
+            continue;
+        }
+        removed.push_back((int) i);
+        if(_members[i])
+            members.push_back((int) i);
+    }
+    int removedCount = (int) removed.size();
+    if(removedCount == 0)
+        return 0;
+    if(keep.empty()) {
+        // nothing left, the model is empty again
+        _projections.release();
+        _sqnorms.release();
+        _eigenvectors.release();
+        _eigenvalues.release();
+        _mean.release();
+        _projection = subspace::Projection();
+        _labels.clear();
+        _members.clear();
+        _num_samples = 0;
+        return removedCount;
+    }
+    Mat P_B = select_rows(_projections, members);
+    Mat P_A = select_rows(_projections, keep);
+    int n = _num_samples;
+    int m = (int) members.size();
+    if(!freeze_basis && m > 0 && n - m <= 0) {
+        // no sample of the PCA is left, the basis stays as a frozen one
+        _num_samples = 0;
+    } else if(!freeze_basis && m > 0) {
+        // computed in double, the model keeps its type
+        int K = _eigenvectors.cols;
+        Mat W, mean;
+        _eigenvectors.convertTo(W, CV_64F);
+        _mean.convertTo(mean, CV_64F);
+        P_B.convertTo(P_B, CV_64F);
+        P_A.convertTo(P_A, CV_64F);
+        Mat meanP;
+        reduce(P_B, meanP, 0, CV_REDUCE_SUM);
+        meanP = meanP * (1.0 / m);
+        Mat S_P, S_B;
+        mulTransposed(P_B, S_P, true);
+        mulTransposed(meanP, S_B, true);
+        Mat S = -(S_P + S_B * ((double) m * m / (n - m)));
+        for(int i = 0; i < K; i++)
+            S.at<double>(i, i) += _eigenvalues.at<double>(i) * n;
+        Mat evals, evecs;
+        eigen(S, evals, evecs);
+        Mat E = transpose(evecs);
+        Mat delta = meanP * (-(double) m / (n - m));
+        // new mean, basis and gallery
+        Mat meanShift;
+        gemm(delta, W, 1.0, Mat(), 0.0, meanShift, GEMM_2_T);
+        Mat(mean + meanShift).convertTo(_mean, _dtype);
+        Mat(W * E).convertTo(_eigenvectors, _dtype);
+        _projection.init(_eigenvectors, _mean);
+        for(int i = 0; i < P_A.rows; i++) {
+            Mat p_i = P_A.row(i);
+            subtract(p_i, delta, p_i);
+        }
+        Mat(P_A * E).convertTo(P_A, _dtype);
+        // the downdate can leave tiny negative eigenvalues
+        _eigenvalues = evals * (1.0 / (n - m));
+        for(int i = 0; i < K; i++)
+            _eigenvalues.at<double>(i) = std::max(_eigenvalues.at<double>(i), 0.0);
+        _num_samples = n - m;
+    }
+    _projections = P_A;
+    vector<int> labels;
+    for(size_t i = 0; i < keep.size(); i++)
+        labels.push_back(_labels[keep[i]]);
+    _labels = labels;
+    vector<bool> flags;
+    for(size_t i = 0; i < keep.size(); i++)
+        flags.push_back(_members[keep[i]]);
+    _members = flags;
+    squared_norms(_projections, _sqnorms);
+    return removedCount;
+}
+
+// The squared distance of a query q to a projection p is expanded into
+// ||p||^2 - 2<p,q> + ||q||^2, so the inner products of a block of queries
+// with all projections are a single GEMM and the nearest neighbor is the
+// argmin of ||p||^2 - 2<p,q>. The expansion loses some precision through
+// cancellation, so the distance of the winner is computed again directly.
+template<typename _Tp>
+static int argmin_distance(const double* sqnorms, const _Tp* dot, int n) {
+    int minIdx = 0;
+    double minVal = DBL_MAX;
+    for(int sampleIdx = 0; sampleIdx < n; sampleIdx++) {
+        double val = sqnorms[sampleIdx] - 2.0*dot[sampleIdx];
+        if(val < minVal) {
+            minVal = val;
+            minIdx = sampleIdx;
+        }
+    }
+    return minIdx;
+}
+
+void Eigenfaces::nearest(const Mat& Q, vector<int>& minClasses, vector<double>& minDists) const {
+    int n = _projections.rows;
+    minClasses.assign(Q.rows, -1);
+    minDists.assign(Q.rows, DBL_MAX);
+    // queries per GEMM, so the inner products take a few MB at most
+    int block = max(1, min(Q.rows, (1 << 19) / n));
+    const double* sqnorms = _sqnorms.ptr<double>(0);
+    Mat dots;
+    for(int q0 = 0; q0 < Q.rows; q0 += block) {
+        Mat Qb = Q.rowRange(q0, min(q0 + block, Q.rows));
+        gemm(Qb, _projections, 1.0, Mat(), 0.0, dots, GEMM_2_T);
+        for(int i = 0; i < Qb.rows; i++) {
+            int minIdx = (dots.depth() == CV_32F) ?
+                    argmin_distance(sqnorms, dots.ptr<float>(i), n) :
+                    argmin_distance(sqnorms, dots.ptr<double>(i), n);
+            double dist = norm(_projections.row(minIdx), Qb.row(i), NORM_L2);
+            if(dist < _threshold) {
+                minDists[q0 + i] = dist;
+                minClasses[q0 + i] = _labels[minIdx];
+            }
+        }
+    }
+}
 
 void Eigenfaces::predict(const Mat& src, int &minClass, double &minDist) {
     if(_projections.empty()) {
@@ -48,15 +471,37 @@ void Eigenfaces::predict(const Mat& src, int &minClass, double &minDist) {
     // project into PCA subspace
     Mat q = project(src.reshape(1,1));
     // find 1-nearest neighbor
-    minDist = DBL_MAX;
-    minClass = -1;
-    for(int sampleIdx = 0; sampleIdx < _projections.size(); sampleIdx++) {
-        double dist = norm(_projections[sampleIdx], q, NORM_L2);
-        if((dist < minDist) && (dist < _threshold)) {
-            minDist = dist;
-            minClass = _labels[sampleIdx];
-        }
+    vector<int> minClasses;
+    vector<double> minDists;
+    nearest(q, minClasses, minDists);
+    minClass = minClasses[0];
+    minDist = minDists[0];
+}
+
+void Eigenfaces::predict(const vector<Mat>& src, vector<int>& minClasses, vector<double>& minDists) {
+    if(_projections.empty()) {
+        string error_message = "This cv::Eigenfaces model is not computed yet. Did you call cv::Eigenfaces::train?";
+        CV_Error(CV_StsError, error_message);
+    }
+    minClasses.clear();
+    minDists.clear();
+    if(src.empty())
+        return;
+    // all samples as rows, asRowMatrix checks they are of equal size
+    Mat data = asRowMatrix(src, _eigenvectors.type());
+    if(_eigenvectors.rows != data.cols) {
+        string error_message = format("Wrong input image size. Reason: Training and Test images must be of equal size! Expected an image with %d elements, but got %d.", _eigenvectors.rows, data.cols);
+        CV_Error(CV_StsError, error_message);
     }
+    // project all samples and find their 1-nearest neighbors
+    nearest(project(data), minClasses, minDists);
+}
+
+vector<int> Eigenfaces::predict(const vector<Mat>& src) {
+    vector<int> labels;
+    vector<double> dummy;
+    predict(src, labels, dummy);
+    return labels;
 }
 
 int Eigenfaces::predict(const Mat& src) {
@@ -66,36 +511,14 @@ int Eigenfaces::predict(const Mat& src) {
     return label;
 }
 
+void Eigenfaces::project(const Mat& src, Mat& dst) {
+    // Y = X*W - 1*(mean*W), a single GEMM with mean*W kept by the model
+    _projection.project(src, dst);
+}
+
 Mat Eigenfaces::project(const Mat& src) {
-    Mat W = _eigenvectors;
-    Mat mean = _mean;
-    // get number of samples and dimension
-    int n = src.rows;
-    int d = src.cols;
-    // make sure the data has the correct shape
-    if(W.rows != d) {
-        string error_message = format("Wrong shapes for given matrices. Was size(src) = (%d,%d), size(W) = (%d,%d).", src.rows, src.cols, W.rows, W.cols);
-        CV_Error(CV_StsBadArg, error_message);
-    }
-    // make sure mean is correct if not empty
-    if(!mean.empty() && (mean.total() != d)) {
-        string error_message = format("Wrong mean shape for the given data matrix. Expected %d, but was %d.", d, mean.total());
-        CV_Error(CV_StsBadArg, error_message);
-    }
-    // create temporary matrices
-    Mat X, Y;
-    // make sure you operate on correct type
-    src.convertTo(X, W.type());
-    // safe to do, because of above assertion
-    // safe to do, because of above assertion
-    if(!mean.empty()) {
-        for(int i=0; i<n; i++) {
-            Mat r_i = X.row(i);
-            subtract(r_i, mean.reshape(1,1), r_i);
-        }
-    }
-    // finally calculate projection as Y = (X-mean)*W
-    gemm(X, W, 1.0, Mat(), 0.0, Y);
+    Mat Y;
+    project(src, Y);
     return Y;
 }
 
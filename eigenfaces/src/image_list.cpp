@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012. Philipp Wagner <bytefish[at]gmx[dot]de>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+#include "opencv2/highgui/highgui.hpp"
+#include "image_list.hpp"
+
+#include <fstream>
+#include <sstream>
+
+void ImageList::read(const string& filename) {
+    std::ifstream file(filename.c_str(), ifstream::in);
+    if(!file) {
+        string error_message = format("Could not open the image list \"%s\".", filename.c_str());
+        CV_Error(CV_StsError, error_message);
+    }
+    std::string line, path, classlabel;
+    // for each line
+    while (std::getline(file, line)) {
+        // split line
+        std::stringstream liness(line);
+        std::getline(liness, path, ';');
+        std::getline(liness, classlabel);
+        // skip empty lines
+        if(path.empty())
+            continue;
+        push_back(path, atoi(classlabel.c_str()));
+    }
+}
+
+void ImageList::push_back(const string& path, int label) {
+    _paths.push_back(path);
+    _labels.push_back(label);
+}
+
+void ImageList::pop_back() {
+    _paths.pop_back();
+    _labels.pop_back();
+}
+
+Mat ImageList::image(int i) const {
+    Mat img = imread(_paths[i], 0);
+    if(img.empty()) {
+        string error_message = format("Could not read image %d (\"%s\").", i, _paths[i].c_str());
+        CV_Error(CV_StsError, error_message);
+    }
+    return img;
+}
+
+void ImageList::rows(int first, int last, Mat& dst, int rtype) const {
+    if(first < 0 || last > size() || first >= last) {
+        string error_message = format("Invalid range [%d,%d) for a list of %d images.", first, last, size());
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    for(int i = first; i < last; i++) {
+        Mat img = image(i);
+        if(!img.isContinuous())
+            img = img.clone();
+        // the first image determines the dimensionality
+        if(i == first)
+            dst.create(last - first, (int) img.total(), rtype);
+        if(img.total() != (size_t) dst.cols) {
+            string error_message = format("Wrong number of elements in image %d (\"%s\"), expected %d, but was %d. All images must be of equal size.", i, _paths[i].c_str(), dst.cols, (int) img.total());
+            CV_Error(CV_StsBadArg, error_message);
+        }
+        Mat row = dst.row(i - first);
+        img.reshape(1, 1).convertTo(row, rtype);
+    }
+}
@@ -2,8 +2,6 @@
 #include "opencv2/highgui/highgui.hpp"
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 
 
@@ -13,62 +11,97 @@
 using namespace std;
 using namespace cv;
 
-void read_csv(const string& filename, vector<Mat>& images, vector<int>& labels) {
-	std::ifstream file(filename.c_str(), ifstream::in);
-	if(!file)
-		throw std::exception();
-	std::string line, path, classlabel;
-	// for each line
-	while (std::getline(file, line)) {
-		// get current line
-		std::stringstream liness(line);
-		// split line
-		std::getline(liness, path, ';');
-		std::getline(liness, classlabel);
-		// push pack the data
-		images.push_back(imread(path,0));
-		labels.push_back(atoi(classlabel.c_str()));
+// Trains a model in double and one in float precision on all images but
+// every step-th, predicts the held out images with both and prints the
+// recognition rates and how far the results of the float model are off.
+void precision_report(const ImageList& images, int num_components, int step = 5) {
+	vector<Mat> train, test;
+	vector<int> trainLabels, testLabels;
+	for(int i = 0; i < images.size(); i++) {
+		if(i % step == step - 1) {
+			test.push_back(images.image(i));
+			testLabels.push_back(images.label(i));
+		} else {
+			train.push_back(images.image(i));
+			trainLabels.push_back(images.label(i));
+		}
 	}
+	if(test.empty() || train.empty()) {
+		cerr << "Not enough images for a precision report." << endl;
+		return;
+	}
+	Eigenfaces model64(train, trainLabels, num_components, DBL_MAX, EIGENFACES_PCA, CV_64FC1);
+	Eigenfaces model32(train, trainLabels, num_components, DBL_MAX, EIGENFACES_PCA, CV_32FC1);
+	vector<int> labels64, labels32;
+	vector<double> dists64, dists32;
+	model64.predict(test, labels64, dists64);
+	model32.predict(test, labels32, dists32);
+	int correct64 = 0, correct32 = 0, agree = 0;
+	double maxError = 0.0;
+	for(size_t i = 0; i < test.size(); i++) {
+		correct64 += (labels64[i] == testLabels[i]);
+		correct32 += (labels32[i] == testLabels[i]);
+		agree += (labels64[i] == labels32[i]);
+		maxError = max(maxError, std::abs(dists64[i] - dists32[i]) / max(dists64[i], DBL_MIN));
+	}
+	double rate64 = static_cast<double>(correct64) / test.size();
+	double rate32 = static_cast<double>(correct32) / test.size();
+	cout << "precision report, " << train.size() << " training and " << test.size() << " test images, " << model64.eigenvectors().cols << " components" << endl;
+	cout << "  CV_64FC1: recognition rate = " << rate64 << endl;
+	cout << "  CV_32FC1: recognition rate = " << rate32 << endl;
+	cout << "  delta = " << (rate32 - rate64) << ", same label for " << agree << "/" << test.size()
+		<< " test images, max relative distance error = " << maxError << endl;
 }
 
 int main(int argc, char *argv[]) {
-	vector<Mat> images;
-	vector<int> labels;
+	ImageList images;
 	// check for command line arguments
-	if(argc != 2) {
-		cout << "usage: " << argv[0] << " <csv.ext>" << endl;
+	bool report = (argc == 3) && (string(argv[2]) == "--precision-report");
+	if(argc != 2 && !report) {
+		cout << "usage: " << argv[0] << " <csv.ext> [--precision-report]" << endl;
 		exit(1);
 	}
 
 	// path to your CSV
 	string fn_csv = string(argv[1]);
-	// read in the images
+	// read in the image list, the images are read when they are needed
 	try {
-		read_csv(fn_csv, images, labels);
+		images.read(fn_csv);
 	} catch(exception& e) {
 		cerr << "Error opening file \"" << fn_csv << "\"." << endl;
 		exit(1);
 	}
-	// get width and height
-	int width = images[0].cols;
-	int height = images[0].rows;
+	// quit if there are not enough images for this demo
+	if(images.size() <= 1) {
+		cerr << "This demo needs at least 2 images to work." << endl;
+		exit(1);
+	}
+	// num_components eigenfaces
+	int num_components = 80;
+	// compare float to double precision instead of the demo
+	if(report) {
+		precision_report(images, num_components);
+		return 0;
+	}
 	// get test instances
-	Mat testSample = images[images.size()-1];
-	int testLabel = labels[labels.size()-1];
+	Mat testSample = images.image(images.size()-1);
+	int testLabel = images.label(images.size()-1);
 	// ... and delete last element
 	images.pop_back();
-	labels.pop_back();
-	// num_components eigenfaces
-	int num_components = 80;
-	// compute the eigenfaces
-	Eigenfaces eigenfaces(images, labels, num_components);
+	// get width and height
+	int width = testSample.cols;
+	int height = testSample.rows;
+	// compute the eigenfaces, streaming the images from disk in chunks
+	Eigenfaces eigenfaces(num_components);
+	eigenfaces.compute(images);
 	// get a prediction
 	int predicted = eigenfaces.predict(testSample);
 	cout << "actual=" << testLabel << " / predicted=" << predicted << endl;
 	// see the reconstruction with num_components
-	Mat p = eigenfaces.project(images[0].reshape(1,1));
+	Mat original = images.image(0);
+	Mat p = eigenfaces.project(original.reshape(1,1));
 	Mat r = eigenfaces.reconstruct(p);
-	imshow("original", images[0]);
+	imshow("original", original);
 	imshow("reconstruction", toGrayscale(r.reshape(1, height)));
 	// get the eigenvectors
 	Mat W = eigenfaces.eigenvectors();
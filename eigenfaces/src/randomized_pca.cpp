@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2012. Philipp Wagner <bytefish[at]gmx[dot]de>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+#include "randomized_pca.hpp"
+#include <float.h>
+
+// Number of rows of data read at once, about 16MB.
+static int block_rows(const Mat& data) {
+    size_t rowSize = data.cols * data.elemSize();
+    return max(1, min(data.rows, (int) ((16 << 20) / max(rowSize, (size_t) 1))));
+}
+
+// Mean of the rows of data as 1 x d CV_64FC1.
+static Mat row_mean(const Mat& data) {
+    Mat sum = Mat::zeros(1, data.cols, CV_64FC1);
+    Mat partial;
+    int block = block_rows(data);
+    for(int i0 = 0; i0 < data.rows; i0 += block) {
+        reduce(data.rowRange(i0, min(i0 + block, data.rows)), partial, 0, CV_REDUCE_SUM, CV_64F);
+        add(sum, partial, sum);
+    }
+    return sum * (1.0 / data.rows);
+}
+
+// Y = (data - 1*mean) * M for a d x l CV_64FC1 matrix M. Every block is
+// data_b*M - 1*(mean*M), a single GEMM in the type of data.
+static void multiply_centered(const Mat& data, const Mat& mean, const Mat& M, Mat& Y) {
+    int block = block_rows(data);
+    Mat Mt, meanM, offsets, Yb;
+    M.convertTo(Mt, data.type());
+    gemm(mean, M, 1.0, Mat(), 0.0, meanM);
+    repeat(meanM, block, 1, offsets);
+    offsets.convertTo(offsets, data.type());
+    Y.create(data.rows, M.cols, CV_64FC1);
+    for(int i0 = 0; i0 < data.rows; i0 += block) {
+        int i1 = min(i0 + block, data.rows);
+        gemm(data.rowRange(i0, i1), Mt, 1.0, offsets.rowRange(0, i1 - i0), -1.0, Yb);
+        Mat dst = Y.rowRange(i0, i1);
+        Yb.convertTo(dst, CV_64F);
+    }
+}
+
+// Z = (data - 1*mean)^T * Y = sum_b data_b^T*Y_b - mean^T*(1^T*Y) for a
+// n x l CV_64FC1 matrix Y.
+static void multiply_centered_t(const Mat& data, const Mat& mean, const Mat& Y, Mat& Z) {
+    int block = block_rows(data);
+    Z = Mat::zeros(data.cols, Y.cols, CV_64FC1);
+    Mat sums = Mat::zeros(1, Y.cols, CV_64FC1);
+    Mat Yb, Zb, partial;
+    for(int i0 = 0; i0 < data.rows; i0 += block) {
+        int i1 = min(i0 + block, data.rows);
+        Y.rowRange(i0, i1).convertTo(Yb, data.type());
+        gemm(data.rowRange(i0, i1), Yb, 1.0, Mat(), 0.0, Zb, GEMM_1_T);
+        Zb.convertTo(Zb, CV_64F);
+        add(Z, Zb, Z);
+        reduce(Y.rowRange(i0, i1), partial, 0, CV_REDUCE_SUM, CV_64F);
+        add(sums, partial, sums);
+    }
+    gemm(mean, sums, 1.0, Mat(), 0.0, partial, GEMM_1_T);
+    subtract(Z, partial, Z);
+}
+
+// Orthonormalizes the columns of the CV_64FC1 matrix Y: with Y^T*Y = V*L*V^T
+// the columns of Y*V*L^(-1/2) are orthonormal. The second pass restores the
+// orthogonality the first loses in the directions of small singular values.
+// Columns without weight (rank deficient data) are dropped.
+static void orthonormalize(Mat& Y) {
+    for(int pass = 0; pass < 2; pass++) {
+        Mat G, evals, evecs;
+        mulTransposed(Y, G, true);
+        eigen(G, evals, evecs);
+        int rank = 0;
+        while(rank < evals.rows && evals.at<double>(rank) > evals.at<double>(0) * DBL_EPSILON * Y.rows)
+            rank++;
+        Mat T(Y.cols, rank, CV_64FC1);
+        for(int j = 0; j < rank; j++) {
+            Mat t = T.col(j);
+            Mat v = evecs.row(j).t() * (1.0 / std::sqrt(evals.at<double>(j)));
+            v.copyTo(t);
+        }
+        Y = Y * T;
+    }
+}
+
+void RandomizedPCA::compute(const Mat& data, int num_components, int oversampling, int iterations) {
+    if(data.empty()) {
+        string error_message = "Empty data was given.";
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    if(data.channels() != 1 || (data.depth() != CV_32F && data.depth() != CV_64F)) {
+        string error_message = format("Data must be of type CV_32FC1 or CV_64FC1, but was %d.", data.type());
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    int n = data.rows;
+    int d = data.cols;
+    int rank = min(n, d);
+    if((num_components <= 0) || (num_components > rank))
+        num_components = rank;
+    // size of the sampled subspace
+    int l = min(num_components + max(oversampling, 0), rank);
+    mean = row_mean(data);
+    // basis of the range of the centered data from random samples of it,
+    // refined by power iterations
+    Mat omega(d, l, CV_64FC1);
+    RNG rng(0x7fffffff); // fixed seed, so results are reproducible
+    rng.fill(omega, RNG::NORMAL, Scalar(0), Scalar(1));
+    Mat Y, Z;
+    multiply_centered(data, mean, omega, Y);
+    orthonormalize(Y);
+    for(int it = 0; it < iterations; it++) {
+        multiply_centered_t(data, mean, Y, Z);
+        orthonormalize(Z);
+        multiply_centered(data, mean, Z, Y);
+        orthonormalize(Y);
+    }
+    // B = Y^T*(data - 1*mean) is small, B*B^T = Z^T*Z with Z = B^T gives its
+    // left singular vectors U and singular values s, the eigenvectors are
+    // the right singular vectors B^T*U*s^-1.
+    multiply_centered_t(data, mean, Y, Z);
+    Mat G, evals, evecs;
+    mulTransposed(Z, G, true);
+    eigen(G, evals, evecs);
+    int k = 0;
+    while(k < min(num_components, evals.rows) && evals.at<double>(k) > evals.at<double>(0) * DBL_EPSILON * n)
+        k++;
+    eigenvectors.create(k, d, CV_64FC1);
+    eigenvalues.create(k, 1, CV_64FC1);
+    for(int i = 0; i < k; i++) {
+        double s = std::sqrt(evals.at<double>(i));
+        Mat v = (Z * evecs.row(i).t()).t() * (1.0 / s);
+        Mat dst = eigenvectors.row(i);
+        v.copyTo(dst);
+        eigenvalues.at<double>(i) = evals.at<double>(i) / n;
+    }
+}
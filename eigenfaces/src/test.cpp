@@ -0,0 +1,292 @@
+// Regression tests for Eigenfaces on synthetic images. Prints every failed
+// check and returns the number of failures:
+//
+//   eigenfaces_test
+
+#include "opencv2/opencv.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "eigenfaces.hpp"
+#include "image_list.hpp"
+#include "randomized_pca.hpp"
+
+using namespace std;
+using namespace cv;
+
+static int failures = 0;
+
+static void check(bool condition, const char* name) {
+    if(!condition) {
+        printf("FAILED: %s\n", name);
+        failures++;
+    }
+}
+
+static bool equal(const Mat& a, const Mat& b) {
+    if(a.size() != b.size() || a.type() != b.type())
+        return false;
+    return a.empty() || norm(a, b, NORM_L2) == 0.0;
+}
+
+// true if both models have the same PCA and gallery
+static bool equal(Eigenfaces& a, Eigenfaces& b) {
+    return equal(a.mean(), b.mean())
+        && equal(a.eigenvectors(), b.eigenvectors())
+        && equal(a.eigenvalues(), b.eigenvalues())
+        && equal(a.projections(), b.projections());
+}
+
+// count random 16x16 images, with the labels first, first+1, ...
+static void random_images(int count, int first, int classes, vector<Mat>& images, vector<int>& labels) {
+    for(int i = 0; i < count; i++) {
+        Mat image(16, 16, CV_8UC1);
+        randu(image, Scalar(0), Scalar(256));
+        images.push_back(image);
+        labels.push_back(first + i % classes);
+    }
+}
+
+// count rows x cols images with a decaying spectrum, 8 random patterns
+// weighted by 40*0.6^j plus noise, with the labels first, first+1, ...
+static void structured_images(int count, int rows, int cols, int first, int classes, RNG& rng, vector<Mat>& images, vector<int>& labels) {
+    Mat patterns(8, rows * cols, CV_64FC1);
+    rng.fill(patterns, RNG::UNIFORM, Scalar(-1), Scalar(1));
+    for(int i = 0; i < count; i++) {
+        Mat c(1, 8, CV_64FC1);
+        for(int j = 0; j < 8; j++)
+            c.at<double>(j) = rng.gaussian(40 * pow(0.6, j));
+        Mat v = c * patterns;
+        Mat image, noise(rows, cols, CV_8UC1);
+        v.reshape(1, rows).convertTo(image, CV_8UC1, 1, 128);
+        rng.fill(noise, RNG::UNIFORM, Scalar(0), Scalar(4));
+        add(image, noise, image);
+        images.push_back(image);
+        labels.push_back(first + i % classes);
+    }
+}
+
+// the images plus noise of at most amplitude gray levels
+static vector<Mat> noisy_copies(const vector<Mat>& images, int amplitude, RNG& rng) {
+    vector<Mat> copies;
+    for(size_t i = 0; i < images.size(); i++) {
+        Mat noise(images[i].size(), CV_16SC1), sum, copy;
+        rng.fill(noise, RNG::UNIFORM, Scalar(-amplitude), Scalar(amplitude + 1));
+        images[i].convertTo(sum, CV_16S);
+        add(sum, noise, sum);
+        sum.convertTo(copy, CV_8U);
+        copies.push_back(copy);
+    }
+    return copies;
+}
+
+// true if both models have the same mean and eigenvalues, and the same first
+// k eigenvectors up to their sign, relative to tolerance
+static bool same_subspace(Eigenfaces& a, Eigenfaces& b, int k, double tolerance) {
+    Mat La = a.eigenvalues(), Lb = b.eigenvalues();
+    if(La.total() != Lb.total() || a.eigenvectors().size() != b.eigenvectors().size())
+        return false;
+    Mat Wa, Wb, ma, mb;
+    a.eigenvectors().convertTo(Wa, CV_64F);
+    b.eigenvectors().convertTo(Wb, CV_64F);
+    a.mean().convertTo(ma, CV_64F);
+    b.mean().convertTo(mb, CV_64F);
+    if(norm(ma.reshape(1, 1), mb.reshape(1, 1), NORM_L2) > tolerance * norm(ma, NORM_L2))
+        return false;
+    for(int i = 0; i < (int) La.total(); i++)
+        if(abs(La.at<double>(i) - Lb.at<double>(i)) > tolerance * La.at<double>(0))
+            return false;
+    for(int i = 0; i < k; i++)
+        if(abs(Wa.col(i).dot(Wb.col(i))) < 1.0 - tolerance)
+            return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// tests
+//------------------------------------------------------------------------------
+
+// samples added with a frozen basis are not part of the PCA, so removing
+// them must not downdate it
+static void test_remove_frozen_samples() {
+    vector<Mat> train, added;
+    vector<int> trainLabels, addedLabels;
+    random_images(40, 0, 8, train, trainLabels);
+    random_images(6, 100, 1, added, addedLabels);
+    // a new label: the model is the one before the update
+    Eigenfaces before(train, trainLabels, 20);
+    Eigenfaces model(train, trainLabels, 20);
+    model.update(added, addedLabels, true);
+    check(model.remove(100) == 6, "remove returns the number of removed samples");
+    check(equal(model, before), "removing frozen samples restores the model before the update");
+    // a label in both: only its PCA samples are downdated
+    vector<int> sharedLabels(added.size(), 3);
+    Eigenfaces expected(train, trainLabels, 20);
+    expected.remove(3);
+    Eigenfaces shared(train, trainLabels, 20);
+    shared.update(added, sharedLabels, true);
+    check(shared.remove(3) == 5 + 6, "remove counts PCA and frozen samples");
+    check(equal(shared, expected), "removing a label with frozen samples downdates its PCA samples only");
+}
+
+// an incremental update followed by removing the added samples must give the
+// PCA back; with all 64 components kept neither step truncates the basis
+static void test_update_and_remove() {
+    RNG rng(3);
+    vector<Mat> train, added;
+    vector<int> trainLabels, addedLabels;
+    structured_images(100, 8, 8, 0, 10, rng, train, trainLabels);
+    structured_images(12, 8, 8, 100, 1, rng, added, addedLabels);
+    Eigenfaces before(train, trainLabels);
+    Eigenfaces model(train, trainLabels);
+    model.update(added, addedLabels);
+    check(!same_subspace(model, before, 8, 1e-3), "update changes the PCA");
+    check(model.remove(100) == 12, "remove returns the number of removed samples");
+    check(same_subspace(model, before, 8, 1e-9), "update and remove restore the PCA");
+    vector<Mat> queries = noisy_copies(train, 2, rng);
+    check(model.predict(queries) == before.predict(queries), "update and remove restore the gallery");
+}
+
+// a model in CV_32FC1 predicts the labels of the model in CV_64FC1, also
+// after an update
+static void test_float_model() {
+    RNG rng(4);
+    vector<Mat> train, added;
+    vector<int> trainLabels, addedLabels;
+    structured_images(60, 16, 16, 0, 12, rng, train, trainLabels);
+    structured_images(10, 16, 16, 100, 2, rng, added, addedLabels);
+    Eigenfaces doubles(train, trainLabels, 30, DBL_MAX, EIGENFACES_PCA, CV_64FC1);
+    Eigenfaces floats(train, trainLabels, 30, DBL_MAX, EIGENFACES_PCA, CV_32FC1);
+    check(floats.dtype() == CV_32FC1 && floats.eigenvectors().type() == CV_32FC1 && floats.projections().type() == CV_32FC1, "CV_32FC1 model stores float");
+    vector<Mat> queries = noisy_copies(train, 2, rng);
+    vector<int> expected = doubles.predict(queries);
+    check(floats.predict(queries) == expected, "CV_32FC1 model predicts the labels of CV_64FC1");
+    check(expected == trainLabels, "noisy copies are predicted as their image");
+    doubles.update(added, addedLabels);
+    floats.update(added, addedLabels);
+    queries.insert(queries.end(), added.begin(), added.end());
+    check(floats.predict(queries) == doubles.predict(queries), "CV_32FC1 model predicts the labels of CV_64FC1 after an update");
+}
+
+// the batch predict gives the labels and distances of one predict per
+// sample, with a threshold between the distances of the noisy copies and
+// those of unrelated images so both outcomes are covered
+static void test_batch_predict() {
+    RNG rng(5);
+    vector<Mat> train, unrelated;
+    vector<int> labels, unusedLabels;
+    structured_images(50, 16, 16, 0, 10, rng, train, labels);
+    random_images(20, 0, 1, unrelated, unusedLabels);
+    vector<Mat> queries = noisy_copies(train, 2, rng);
+    queries.insert(queries.end(), unrelated.begin(), unrelated.end());
+    for(int type = CV_32F; type <= CV_64F; type++) {
+        Eigenfaces unlimited(train, labels, 20, DBL_MAX, EIGENFACES_PCA, type);
+        vector<double> distances;
+        for(size_t i = 0; i < queries.size(); i++) {
+            int label;
+            double distance;
+            unlimited.predict(queries[i], label, distance);
+            distances.push_back(distance);
+        }
+        // halfway between the largest distance of a noisy copy and the smallest of an unrelated image
+        double threshold = 0.5 * (*max_element(distances.begin(), distances.begin() + train.size())
+                + *min_element(distances.begin() + train.size(), distances.end()));
+        Eigenfaces model(train, labels, 20, threshold, EIGENFACES_PCA, type);
+        vector<int> batchLabels;
+        vector<double> batchDistances;
+        model.predict(queries, batchLabels, batchDistances);
+        check(batchLabels.size() == queries.size() && batchDistances.size() == queries.size(), "batch predict returns one label per sample");
+        if(batchLabels.size() != queries.size())
+            continue;
+        bool same = true;
+        int rejected = 0;
+        for(size_t i = 0; i < queries.size(); i++) {
+            int label;
+            double distance;
+            model.predict(queries[i], label, distance);
+            same = same && label == batchLabels[i] && abs(distance - batchDistances[i]) <= 1e-5 * distances[i];
+            rejected += (label == -1);
+        }
+        check(same, type == CV_32F ? "batch predict equals predict, CV_32FC1" : "batch predict equals predict, CV_64FC1");
+        check(rejected == (int) unrelated.size(), "the threshold rejects the unrelated images only");
+        check(model.predict(queries) == batchLabels, "batch predict without distances");
+    }
+}
+
+// RandomizedPCA against cv::PCA on data with a decaying spectrum: 300
+// samples of rank 60, singular values falling by 0.85, 20 components
+static void test_randomized_pca() {
+    const int n = 300, d = 400, r = 60, k = 20;
+    RNG rng(1);
+    Mat U(n, r, CV_64FC1), V(r, d, CV_64FC1);
+    rng.fill(U, RNG::NORMAL, Scalar(0), Scalar(1));
+    rng.fill(V, RNG::NORMAL, Scalar(0), Scalar(1));
+    for(int j = 0; j < r; j++) {
+        Mat c = U.col(j);
+        Mat scaled = c * (40.0 * pow(0.85, j));
+        scaled.copyTo(c);
+    }
+    Mat data = U * V;
+    for(int i = 0; i < n; i++)
+        for(int j = 0; j < d; j++)
+            data.at<double>(i, j) += 100 + 0.01 * j;
+    PCA exact(data, Mat(), CV_PCA_DATA_AS_ROW, k);
+    for(int type = CV_32F; type <= CV_64F; type++) {
+        Mat X;
+        data.convertTo(X, type);
+        RandomizedPCA approx(X, k);
+        check(approx.eigenvectors.rows == k, "RandomizedPCA computes the requested components");
+        if(approx.eigenvectors.rows != k)
+            continue;
+        double maxRelative = 0.0, minCosine = 1.0;
+        for(int i = 0; i < k; i++) {
+            double a = exact.eigenvalues.at<double>(i), b = approx.eigenvalues.at<double>(i);
+            maxRelative = max(maxRelative, abs(a - b) / a);
+            minCosine = min(minCosine, abs(exact.eigenvectors.row(i).dot(approx.eigenvectors.row(i))));
+        }
+        check(maxRelative <= 1e-6, "RandomizedPCA eigenvalues match cv::PCA");
+        check(minCosine >= 1.0 - 1e-6, "RandomizedPCA eigenvectors match cv::PCA");
+        check(norm(exact.mean.reshape(1, 1), approx.mean, NORM_L2) <= 1e-6 * norm(approx.mean, NORM_L2), "RandomizedPCA mean");
+    }
+}
+
+// compute(ImageList) reads the images from disk in chunks, it must give the
+// PCA of compute(vector<Mat>): the Gram branch with 60 images of 120 pixels,
+// the covariance branch with 150 images of 64 pixels
+static void test_compute_image_list() {
+    const int sizes[][4] = { { 12, 10, 60, 7 }, { 8, 8, 150, 13 } }; // rows, cols, images, chunk size
+    for(int c = 0; c < 2; c++) {
+        int rows = sizes[c][0], cols = sizes[c][1], n = sizes[c][2], chunk = sizes[c][3];
+        RNG rng(c + 1);
+        vector<Mat> images;
+        vector<int> labels;
+        structured_images(n, rows, cols, 0, 20, rng, images, labels);
+        ImageList list;
+        for(int i = 0; i < n; i++) {
+            string path = format("eigenfaces_test_%d.png", i);
+            imwrite(path, images[i]);
+            list.push_back(path, labels[i]);
+        }
+        Eigenfaces expected(images, labels, 20);
+        Eigenfaces streamed(20);
+        streamed.compute(list, chunk);
+        for(int i = 0; i < n; i++)
+            remove(list.path(i).c_str());
+        check(same_subspace(expected, streamed, 8, 1e-9), c == 0 ? "compute(ImageList), Gram branch" : "compute(ImageList), covariance branch");
+        vector<Mat> queries = noisy_copies(images, 2, rng);
+        check(expected.predict(queries) == streamed.predict(queries), "compute(ImageList) predicts like compute(vector<Mat>)");
+    }
+}
+
+int main() {
+    test_remove_frozen_samples();
+    test_randomized_pca();
+    test_compute_image_list();
+    test_update_and_remove();
+    test_float_model();
+    test_batch_predict();
+    printf("%d failure(s)\n", failures);
+    return failures;
+}
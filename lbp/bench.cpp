@@ -0,0 +1,230 @@
+// Benchmarks the lbp operators and histograms on synthetic data and writes
+// the results as JSON to stdout, so runs can be diffed:
+//
+//   lbp_bench [--quick] [--filter <substring>] [--min-time <seconds>] [--threads <n>]
+//
+// For every case it reports the median time per call in ns/pixel, the
+// bandwidth (bytes read and written per call over the median time) and the
+// heap allocations per call, with the destination reused between calls.
+
+#include <cv.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "lbp.hpp"
+#include "histogram.hpp"
+
+using namespace cv;
+using namespace std;
+
+//------------------------------------------------------------------------------
+// allocation counting
+//------------------------------------------------------------------------------
+
+// Counts the calls to malloc, which backs both operator new and
+// cv::fastMalloc. Only available with glibc, elsewhere allocs_per_call is
+// reported as -1.
+static volatile long allocations = 0;
+
+#if defined(__GLIBC__)
+extern "C" {
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+	__sync_fetch_and_add(&allocations, 1);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+	__sync_fetch_and_add(&allocations, 1);
+	return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+	__sync_fetch_and_add(&allocations, 1);
+	return __libc_realloc(ptr, size);
+}
+}
+static const bool counting = true;
+#else
+static const bool counting = false;
+#endif
+
+//------------------------------------------------------------------------------
+// cases
+//------------------------------------------------------------------------------
+
+enum Operator { BENCH_OLBP, BENCH_ELBP, BENCH_VARLBP, BENCH_HISTOGRAM, BENCH_SPATIAL_HISTOGRAM };
+
+static const char* operator_name(int op) {
+	switch(op) {
+		case BENCH_OLBP: return "OLBP";
+		case BENCH_ELBP: return "ELBP";
+		case BENCH_VARLBP: return "VARLBP";
+		case BENCH_HISTOGRAM: return "histogram";
+		case BENCH_SPATIAL_HISTOGRAM: return "spatial_histogram";
+	}
+	return "unknown";
+}
+
+static const char* type_name(int type) {
+	switch(type) {
+		case CV_8SC1: return "CV_8SC1";
+		case CV_8UC1: return "CV_8UC1";
+		case CV_16SC1: return "CV_16SC1";
+		case CV_16UC1: return "CV_16UC1";
+		case CV_32SC1: return "CV_32SC1";
+		case CV_32FC1: return "CV_32FC1";
+		case CV_64FC1: return "CV_64FC1";
+	}
+	return "unknown";
+}
+
+struct Case {
+	int op;
+	int type; // of the input, for the histograms the type of the codes
+	int radius, neighbors;
+	Size size;
+
+	string name() const {
+		return format("%s/%s/r%d_p%d/%dx%d", operator_name(op), type_name(type), radius, neighbors, size.width, size.height);
+	}
+};
+
+struct Result {
+	int calls;
+	double ns_per_pixel;
+	double gb_per_s;
+	double allocs_per_call;
+};
+
+// random input in the range of the type, codes below numPatterns for the histograms
+static Mat synthetic(const Case& c) {
+	Mat src(c.size, c.type);
+	if(c.op == BENCH_HISTOGRAM || c.op == BENCH_SPATIAL_HISTOGRAM) {
+		int numPatterns = 1 << c.neighbors;
+		randu(src, Scalar(0), Scalar(numPatterns-1));
+	} else if(c.type == CV_8SC1) {
+		randu(src, Scalar(-128), Scalar(128));
+	} else {
+		randu(src, Scalar(0), Scalar(256));
+	}
+	return src;
+}
+
+static void run(const Case& c, const Mat& src, Mat& dst) {
+	switch(c.op) {
+		case BENCH_OLBP: lbp::OLBP(src, dst); break;
+		case BENCH_ELBP: lbp::ELBP(src, dst, c.radius, c.neighbors); break;
+		case BENCH_VARLBP: lbp::VARLBP(src, dst, c.radius, c.neighbors); break;
+		case BENCH_HISTOGRAM: lbp::histogram(src, dst, 1 << c.neighbors); break;
+		case BENCH_SPATIAL_HISTOGRAM: lbp::spatial_histogram(src, dst, 1 << c.neighbors, 8, 8); break;
+	}
+}
+
+static double now() {
+	return static_cast<double>(getTickCount()) / getTickFrequency();
+}
+
+static Result measure(const Case& c, double minTime) {
+	Mat src = synthetic(c);
+	Mat dst;
+	run(c, src, dst); // warm up and allocate dst
+	vector<double> times;
+	times.reserve(10000); // don't count our own allocations
+	long allocs = allocations;
+	double start = now();
+	while(times.size() < 3 || (now() - start < minTime && times.size() < 10000)) {
+		double t0 = now();
+		run(c, src, dst);
+		times.push_back(now() - t0);
+	}
+	allocs = allocations - allocs;
+	sort(times.begin(), times.end());
+	double median = times[times.size()/2];
+	double bytes = static_cast<double>(src.total()*src.elemSize() + dst.total()*dst.elemSize());
+	Result r;
+	r.calls = static_cast<int>(times.size());
+	r.ns_per_pixel = median * 1e9 / static_cast<double>(src.total());
+	r.gb_per_s = bytes / median / 1e9;
+	r.allocs_per_call = counting ? static_cast<double>(allocs) / r.calls : -1.0;
+	return r;
+}
+
+int main(int argc, const char *argv[]) {
+	bool quick = false;
+	string filter;
+	double minTime = 0.1;
+	int threads = lbp::getNumThreads();
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--quick") == 0) {
+			quick = true;
+		} else if(strcmp(argv[i], "--filter") == 0 && i+1 < argc) {
+			filter = argv[++i];
+		} else if(strcmp(argv[i], "--min-time") == 0 && i+1 < argc) {
+			minTime = atof(argv[++i]);
+		} else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+			threads = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--quick] [--filter <substring>] [--min-time <seconds>] [--threads <n>]\n", argv[0]);
+			return -1;
+		}
+	}
+	lbp::setNumThreads(threads);
+
+	vector<Size> sizes;
+	sizes.push_back(Size(64, 64));
+	sizes.push_back(Size(256, 256));
+	sizes.push_back(Size(640, 480));
+	if(!quick) {
+		sizes.push_back(Size(1920, 1080));
+		sizes.push_back(Size(3840, 2160));
+	}
+	int types[] = { CV_8SC1, CV_8UC1, CV_16SC1, CV_16UC1, CV_32SC1, CV_32FC1, CV_64FC1 };
+	int scales[][2] = { {1, 8}, {2, 8}, {2, 16}, {3, 24} };
+	// the code images the operators produce
+	int codes[][2] = { {CV_8UC1, 8}, {CV_16UC1, 16}, {CV_32SC1, 8}, {CV_32SC1, 16} };
+
+	vector<Case> cases;
+	for(size_t s = 0; s < sizes.size(); s++) {
+		for(int t = 0; t < 7; t++) {
+			Case c = { BENCH_OLBP, types[t], 1, 8, sizes[s] };
+			cases.push_back(c);
+			for(int k = 0; k < 4; k++) {
+				Case e = { BENCH_ELBP, types[t], scales[k][0], scales[k][1], sizes[s] };
+				cases.push_back(e);
+				Case v = { BENCH_VARLBP, types[t], scales[k][0], scales[k][1], sizes[s] };
+				cases.push_back(v);
+			}
+		}
+		for(int k = 0; k < 4; k++) {
+			Case h = { BENCH_HISTOGRAM, codes[k][0], 0, codes[k][1], sizes[s] };
+			cases.push_back(h);
+			Case sh = { BENCH_SPATIAL_HISTOGRAM, codes[k][0], 0, codes[k][1], sizes[s] };
+			cases.push_back(sh);
+		}
+	}
+
+	printf("{\n  \"threads\": %d,\n  \"min_time\": %g,\n  \"benchmarks\": [", threads, minTime);
+	bool first = true;
+	for(size_t i = 0; i < cases.size(); i++) {
+		const Case& c = cases[i];
+		string name = c.name();
+		if(!filter.empty() && name.find(filter) == string::npos)
+			continue;
+		Result r = measure(c, minTime);
+		printf("%s\n    {\"name\": \"%s\", \"op\": \"%s\", \"type\": \"%s\", \"radius\": %d, \"neighbors\": %d, "
+			"\"width\": %d, \"height\": %d, \"calls\": %d, \"ns_per_pixel\": %.4f, \"gb_per_s\": %.4f, \"allocs_per_call\": %.2f}",
+			first ? "" : ",", name.c_str(), operator_name(c.op), type_name(c.type), c.radius, c.neighbors,
+			c.size.width, c.size.height, r.calls, r.ns_per_pixel, r.gb_per_s, r.allocs_per_call);
+		fflush(stdout);
+		first = false;
+	}
+	printf("\n  ]\n}\n");
+	return 0;
+}
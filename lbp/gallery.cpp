@@ -0,0 +1,293 @@
+#include "gallery.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// templates per parallel band
+static const int BAND = 4096;
+// bins summed before the partial distance is checked against the bound
+static const int CHUNK = 64;
+
+// Chi-square distance of two padded float histograms. Returns as soon as
+// the partial sum exceeds bound, the result is then only a lower bound.
+static double chi_square_abandon(const float* q, const float* t, int len, double bound, bool sse) {
+	const float eps = static_cast<float>(numeric_limits<double>::epsilon());
+	double result = 0.0;
+	int i = 0;
+	while(i < len) {
+		int end = min(i + CHUNK, len);
+		float acc = 0.f;
+#ifdef LBP_SSE2
+		if(sse) {
+			const __m128 veps = _mm_set1_ps(eps);
+			const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			__m128 vacc = _mm_setzero_ps();
+			for(; i <= end - 4; i += 4) {
+				__m128 a = _mm_loadu_ps(q + i);
+				__m128 b = _mm_loadu_ps(t + i);
+				__m128 d = _mm_sub_ps(a, b);
+				__m128 s = _mm_add_ps(a, b);
+				__m128 mask = _mm_cmpgt_ps(_mm_and_ps(s, absmask), veps);
+				vacc = _mm_add_ps(vacc, _mm_and_ps(_mm_div_ps(_mm_mul_ps(d, d), s), mask));
+			}
+			float buf[4];
+			_mm_storeu_ps(buf, vacc);
+			acc = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+		}
+#else
+		(void)sse;
+#endif
+		for(; i < end; i++) {
+			float d = q[i] - t[i];
+			float s = q[i] + t[i];
+			if(std::abs(s) > eps)
+				acc += d*d/s;
+		}
+		result += acc;
+		if(result > bound)
+			break;
+	}
+	return result;
+}
+
+typedef pair<double,int> Match; // (distance, index)
+
+// The k best matches of a search, shared by all bands. Every band reads the
+// current bound now and then and only takes the lock to offer a match that
+// beats it, so the bands prune with what the others have found.
+class SharedBest {
+public:
+	SharedBest(int k) : k(k), _bound(numeric_limits<double>::max()) {
+		best.reserve(k);
+	}
+
+	double bound() const {
+		AutoLock lock(mutex);
+		return _bound;
+	}
+
+	// pushes a match if it is among the k best, returns the new bound
+	double offer(double distance, int index) {
+		AutoLock lock(mutex);
+		Match m(distance, index);
+		if((int)best.size() < k) {
+			best.push_back(m);
+			push_heap(best.begin(), best.end());
+		} else if(m < best.front()) {
+			pop_heap(best.begin(), best.end());
+			best.back() = m;
+			push_heap(best.begin(), best.end());
+		}
+		if((int)best.size() == k)
+			_bound = best.front().first;
+		return _bound;
+	}
+
+	vector<Match> sorted() const {
+		vector<Match> result(best);
+		sort_heap(result.begin(), result.end());
+		return result;
+	}
+
+private:
+	int k;
+	double _bound;
+	vector<Match> best; // max-heap
+	mutable Mutex mutex;
+};
+
+// templates visited between two reads of the shared bound
+static const int REFRESH = 64;
+
+class GallerySearchInvoker : public ParallelLoopBody {
+public:
+	GallerySearchInvoker(const float* query, const float* coarseQuery,
+			const float* data, int stride, const float* coarse, int coarseStride,
+			int size, bool sse, SharedBest& best) :
+		query(query), coarseQuery(coarseQuery), data(data), stride(stride),
+		coarse(coarse), coarseStride(coarseStride), size(size), sse(sse),
+		best(&best) {}
+
+	void operator()(const Range& range) const {
+		for(int band = range.start; band < range.end; band++) {
+			int begin = band * BAND;
+			int end = min(begin + BAND, size);
+			double bound = best->bound();
+			if(coarse) {
+				// visit the templates by ascending lower bound
+				vector<Match> order(end - begin);
+				for(int i = begin; i < end; i++)
+					order[i-begin] = Match(chi_square_abandon(coarseQuery, coarse + (size_t)i*coarseStride, coarseStride, numeric_limits<double>::max(), sse), i);
+				sort(order.begin(), order.end());
+				for(int n = 0; n < (int)order.size(); n++) {
+					if(n % REFRESH == 0)
+						bound = best->bound();
+					if(order[n].first > bound)
+						break;
+					int i = order[n].second;
+					double d = chi_square_abandon(query, data + (size_t)i*stride, stride, bound, sse);
+					if(d <= bound)
+						bound = best->offer(d, i);
+				}
+			} else {
+				for(int i = begin; i < end; i++) {
+					if((i - begin) % REFRESH == 0)
+						bound = best->bound();
+					double d = chi_square_abandon(query, data + (size_t)i*stride, stride, bound, sse);
+					if(d <= bound)
+						bound = best->offer(d, i);
+				}
+			}
+		}
+	}
+
+private:
+	const float* query;
+	const float* coarseQuery;
+	const float* data;
+	int stride;
+	const float* coarse;
+	int coarseStride;
+	int size;
+	bool sse;
+	SharedBest* best;
+};
+
+lbp::LBPHGallery::LBPHGallery(int reduction) :
+	_reduction(reduction > 1 ? reduction : 0),
+	_dims(0), _stride(0), _coarseDims(0), _coarseStride(0),
+	_size(0), _capacity(0), _data(0), _coarse(0) {}
+
+void lbp::LBPHGallery::clear() {
+	_dims = _stride = _coarseDims = _coarseStride = 0;
+	_size = _capacity = 0;
+	_storage.release();
+	_coarseStorage.release();
+	_data = _coarse = 0;
+	_labels.clear();
+}
+
+// Reallocates the template storage, rows stay 64 byte aligned.
+void lbp::LBPHGallery::grow(int capacity) {
+	if(capacity <= _capacity || _dims == 0)
+		return;
+	Mat storage(1, capacity*_stride + 16, CV_32FC1);
+	float* data = alignPtr(storage.ptr<float>(0), 64);
+	if(_size > 0)
+		memcpy(data, _data, (size_t)_size*_stride*sizeof(float));
+	_storage = storage;
+	_data = data;
+	if(_reduction) {
+		Mat coarseStorage(1, capacity*_coarseStride + 16, CV_32FC1);
+		float* coarse = alignPtr(coarseStorage.ptr<float>(0), 64);
+		if(_size > 0)
+			memcpy(coarse, _coarse, (size_t)_size*_coarseStride*sizeof(float));
+		_coarseStorage = coarseStorage;
+		_coarse = coarse;
+	}
+	_capacity = capacity;
+}
+
+void lbp::LBPHGallery::reserve(int n) {
+	// without a template the row size isn't known yet, the first add
+	// allocates the reserved capacity
+	_labels.reserve(n);
+	grow(n);
+}
+
+// Converts a histogram to float and writes it to a padded row, and the
+// summed bins to a padded coarse row if coarse is given.
+void lbp::LBPHGallery::prepare(const Mat& src, float* fine, float* coarse) const {
+	if((int)src.total() != _dims || src.channels() != 1)
+		CV_Error(CV_StsBadArg, format("Wrong number of bins. Expected %d, but was %d.", _dims, (int)src.total()));
+	Mat hist = src.isContinuous() ? src : src.clone();
+	Mat row(1, _dims, CV_32FC1, fine);
+	hist.reshape(1, 1).convertTo(row, CV_32F);
+	std::fill(fine + _dims, fine + _stride, 0.f);
+	if(coarse) {
+		std::fill(coarse, coarse + _coarseStride, 0.f);
+		for(int i = 0; i < _dims; i++)
+			coarse[i/_reduction] += fine[i];
+	}
+}
+
+void lbp::LBPHGallery::add(const Mat& hist, int label) {
+	if(_dims == 0) {
+		if(hist.total() == 0)
+			CV_Error(CV_StsBadArg, "Empty histogram given.");
+		_dims = (int)hist.total();
+		_stride = (int)alignSize(_dims, 16);
+		if(_reduction) {
+			_coarseDims = (_dims + _reduction - 1) / _reduction;
+			_coarseStride = (int)alignSize(_coarseDims, 16);
+		}
+		grow(max((int)_labels.capacity(), 16));
+	}
+	if(_size == _capacity)
+		grow(2*_capacity);
+	prepare(hist, _data + (size_t)_size*_stride, _reduction ? _coarse + (size_t)_size*_coarseStride : 0);
+	_labels.push_back(label);
+	_size++;
+}
+
+void lbp::LBPHGallery::add(const vector<Mat>& hists, const vector<int>& labels) {
+	if(hists.size() != labels.size())
+		CV_Error(CV_StsBadArg, format("The number of histograms (%d) doesn't match the number of labels (%d).", (int)hists.size(), (int)labels.size()));
+	if(!hists.empty()) {
+		add(hists[0], labels[0]);
+		grow(_size + (int)hists.size() - 1);
+	}
+	for(size_t i = 1; i < hists.size(); i++)
+		add(hists[i], labels[i]);
+}
+
+Mat lbp::LBPHGallery::templates() const {
+	if(_size == 0)
+		return Mat();
+	return Mat(_size, _dims, CV_32FC1, _data, _stride*sizeof(float));
+}
+
+void lbp::LBPHGallery::search(const Mat& query, int k, vector<int>& indices, vector<double>& distances) const {
+	indices.clear();
+	distances.clear();
+	k = min(k, _size);
+	if(k <= 0)
+		return;
+	// padded query, 64 byte aligned like the templates
+	Mat buffer(1, _stride + _coarseStride + 32, CV_32FC1);
+	float* q = alignPtr(buffer.ptr<float>(0), 64);
+	float* cq = _reduction ? alignPtr(q + _stride, 64) : 0;
+	prepare(query, q, cq);
+	bool sse = false;
+#ifdef LBP_SSE2
+	sse = haveSSE2();
+#endif
+	int bands = (_size + BAND - 1) / BAND;
+	SharedBest shared(k);
+	parallel_for_(Range(0, bands),
+		GallerySearchInvoker(q, cq, _data, _stride, _coarse, _coarseStride, _size, sse, shared),
+		bands);
+	vector<Match> best = shared.sorted();
+	for(int i = 0; i < k; i++) {
+		indices.push_back(best[i].second);
+		distances.push_back(best[i].first);
+	}
+}
+
+int lbp::LBPHGallery::predict(const Mat& query, double& distance) const {
+	vector<int> indices;
+	vector<double> distances;
+	search(query, 1, indices, distances);
+	if(indices.empty()) {
+		distance = numeric_limits<double>::max();
+		return -1;
+	}
+	distance = distances[0];
+	return _labels[indices[0]];
+}
+
+int lbp::LBPHGallery::predict(const Mat& query) const {
+	double distance;
+	return predict(query, distance);
+}
@@ -0,0 +1,67 @@
+#ifndef GALLERY_HPP_
+#define GALLERY_HPP_
+
+//! \author philipp <bytefish[at]gmx[dot]de>
+//! \copyright BSD, see LICENSE.
+
+#include <cv.h>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+namespace lbp {
+
+// Nearest neighbor search over enrolled (spatial) LBP histograms with the
+// chi-square distance. The templates are stored as float in one contiguous
+// matrix, every row starts on a 64 byte boundary and is padded with zeros.
+//
+// A search keeps the k best distances seen so far and abandons a template
+// as soon as its partial sum exceeds the k-th of them. With reduction > 1
+// the gallery also keeps a coarse copy of every template, where reduction
+// adjacent bins are summed into one. By Cauchy-Schwarz the chi-square
+// distance of the coarse histograms is a lower bound of the full one (for
+// non-negative histograms), so the templates are visited in the order of
+// their coarse distance and the search stops at the first one whose bound
+// exceeds the k-th best. Both stages are exact up to float rounding.
+class LBPHGallery {
+public:
+	LBPHGallery(int reduction = 0);
+
+	//! enrolls a histogram of any type and shape, all must have the same size
+	void add(const Mat& hist, int label);
+	void add(const vector<Mat>& hists, const vector<int>& labels);
+	//! preallocates space for n templates
+	void reserve(int n);
+	void clear();
+
+	//! label of the nearest template, or -1 if the gallery is empty
+	int predict(const Mat& query) const;
+	int predict(const Mat& query, double& distance) const;
+	//! indices of the k nearest templates, sorted by ascending distance
+	void search(const Mat& query, int k, vector<int>& indices, vector<double>& distances) const;
+
+	int size() const { return _size; }
+	int dims() const { return _dims; }
+	int reduction() const { return _reduction; }
+	int label(int index) const { return _labels[index]; }
+	const vector<int>& labels() const { return _labels; }
+	//! size() x dims() CV_32FC1 header on the stored templates
+	Mat templates() const;
+
+private:
+	void grow(int capacity);
+	void prepare(const Mat& src, float* fine, float* coarse) const;
+
+	int _reduction;
+	int _dims, _stride; // bins per template and floats per row
+	int _coarseDims, _coarseStride;
+	int _size, _capacity;
+	Mat _storage, _coarseStorage; // unaligned allocations behind _data and _coarse
+	float* _data;
+	float* _coarse;
+	vector<int> _labels;
+};
+
+}
+#endif
@@ -1,15 +1,60 @@
 #include "histogram.hpp"
+#include "simd.hpp"
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
+// Computes the origins of the cells of a spatial histogram, with the same
+// layout as lbp::spatial_histogram: cells are enumerated column by column.
+static void grid_cells(int width, int height, const Size& window, int overlap, vector<int>& xs, vector<int>& ys) {
+	if(window.width-overlap <= 0 || window.height-overlap <= 0)
+		CV_Error(CV_StsBadArg, "The overlap must be smaller than the window size.");
+	xs.clear();
+	ys.clear();
+	xs.reserve(max(0, (width - window.width + window.width-overlap - 1) / (window.width-overlap)));
+	ys.reserve(max(0, (height - window.height + window.height-overlap - 1) / (window.height-overlap)));
+	for(int x=0; x < width - window.width; x+=(window.width-overlap))
+		xs.push_back(x);
+	for(int y=0; y < height - window.height; y+=(window.height-overlap))
+		ys.push_back(y);
+}
+
+// Counts the codes into a 1 x numPatterns CV_32SC1 histogram, hist is
+// reused if it already has that size.
 template <typename _Tp>
 void lbp::histogram_(const Mat& src, Mat& hist, int numPatterns) {
-	hist = Mat::zeros(1, numPatterns, CV_32SC1);
+	hist.create(1, numPatterns, CV_32SC1);
+	hist.setTo(Scalar(0));
+	int* h = hist.ptr<int>(0);
 	for(int i = 0; i < src.rows; i++) {
-		for(int j = 0; j < src.cols; j++) {
-			int bin = src.at<_Tp>(i,j);
-			hist.at<int>(0,bin) += 1;
+		const _Tp* c = src.ptr<_Tp>(i);
+		for(int j = 0; j < src.cols; j++)
+			h[static_cast<int>(c[j])]++;
+	}
+}
+
+// 8 bit codes count into four interleaved sub-histograms on the stack, so
+// runs of equal codes (flat regions) don't wait on the same counter.
+template <>
+void lbp::histogram_<unsigned char>(const Mat& src, Mat& hist, int numPatterns) {
+	hist.create(1, numPatterns, CV_32SC1);
+	int counts[4][256];
+	memset(counts, 0, sizeof(counts));
+	for(int i = 0; i < src.rows; i++) {
+		const unsigned char* c = src.ptr<unsigned char>(i);
+		int j = 0;
+		for(; j <= src.cols - 4; j += 4) {
+			counts[0][c[j]]++;
+			counts[1][c[j+1]]++;
+			counts[2][c[j+2]]++;
+			counts[3][c[j+3]]++;
 		}
+		for(; j < src.cols; j++)
+			counts[0][c[j]]++;
 	}
+	int* h = hist.ptr<int>(0);
+	for(int k = 0; k < numPatterns; k++)
+		h[k] = (k < 256) ? counts[0][k] + counts[1][k] + counts[2][k] + counts[3][k] : 0;
 }
 
 template <typename _Tp>
@@ -30,24 +75,436 @@ double lbp::chi_square_(const Mat& histogram0, const Mat& histogram1) {
 }
 
 
+template <typename _Tp>
+void lbp::integral_histogram_(const Mat& src, Mat& sum, int numPatterns, const Size& block) {
+	int bx = (src.cols + block.width - 1) / block.width;
+	int by = (src.rows + block.height - 1) / block.height;
+	int stride = (bx+1)*numPatterns;
+	sum.create(by+1, stride, CV_32SC1);
+	sum.row(0).setTo(Scalar(0));
+	// histograms of the blocks in the current block row
+	vector<int> acc(bx*numPatterns);
+	for(int y=0; y<by; y++) {
+		std::fill(acc.begin(), acc.end(), 0);
+		for(int i=y*block.height; i<min((y+1)*block.height, src.rows); i++) {
+			const _Tp* c = src.ptr<_Tp>(i);
+			for(int j=0; j<src.cols; j++) {
+				int bin = c[j];
+				acc[(j/block.width)*numPatterns + bin] += 1;
+			}
+		}
+		// S(y+1,x+1) = S(y,x+1) + sum of the block histograms 0..x in this row
+		const int* prev = sum.ptr<int>(y);
+		int* cur = sum.ptr<int>(y+1);
+		for(int k=0; k<numPatterns; k++)
+			cur[k] = 0;
+		for(int x=0; x<bx; x++) {
+			const int* a = &acc[x*numPatterns];
+			const int* left = cur + x*numPatterns;
+			const int* up = prev + (x+1)*numPatterns;
+			int* out = cur + (x+1)*numPatterns;
+			for(int k=0; k<numPatterns; k++)
+				out[k] = up[k] + (left[k] - prev[x*numPatterns+k]) + a[k];
+		}
+	}
+}
+
+void lbp::IntegralHistogram::compute(const Mat& src, int numPatterns, const Size& block) {
+	_numPatterns = numPatterns;
+	_block = block;
+	switch(src.type()) {
+		case CV_8SC1: integral_histogram_<char>(src, _sum, numPatterns, block); break;
+		case CV_8UC1: integral_histogram_<unsigned char>(src, _sum, numPatterns, block); break;
+		case CV_16SC1: integral_histogram_<short>(src, _sum, numPatterns, block); break;
+		case CV_16UC1: integral_histogram_<unsigned short>(src, _sum, numPatterns, block); break;
+		case CV_32SC1: integral_histogram_<int>(src, _sum, numPatterns, block); break;
+		default: CV_Error(CV_StsUnsupportedFormat, "Only integer code images are supported.");
+	}
+}
+
+void lbp::IntegralHistogram::cell(const Rect& rect, int* hist) const {
+	int x0 = rect.x / _block.width * _numPatterns;
+	int x1 = (rect.x + rect.width + _block.width - 1) / _block.width * _numPatterns;
+	const int* top = _sum.ptr<int>(rect.y / _block.height);
+	const int* bottom = _sum.ptr<int>((rect.y + rect.height + _block.height - 1) / _block.height);
+	for(int k=0; k<_numPatterns; k++)
+		hist[k] = bottom[x1+k] - bottom[x0+k] - top[x1+k] + top[x0+k];
+}
+
+// adds the codes of a cell to hist
+template <typename _Tp>
+static void cell_histogram_(const Mat& src, const Rect& rect, int* hist) {
+	for(int i=rect.y; i<rect.y+rect.height; i++) {
+		const _Tp* c = src.ptr<_Tp>(i) + rect.x;
+		for(int j=0; j<rect.width; j++) {
+			int bin = c[j];
+			hist[bin] += 1;
+		}
+	}
+}
+
+static void cell_histogram(const Mat& src, const Rect& rect, int* hist) {
+	switch(src.type()) {
+		case CV_8SC1: cell_histogram_<char>(src, rect, hist); break;
+		case CV_8UC1: cell_histogram_<unsigned char>(src, rect, hist); break;
+		case CV_16SC1: cell_histogram_<short>(src, rect, hist); break;
+		case CV_16UC1: cell_histogram_<unsigned short>(src, rect, hist); break;
+		case CV_32SC1: cell_histogram_<int>(src, rect, hist); break;
+	}
+}
+
+static int gcd(int a, int b) {
+	while(b != 0) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
 void lbp::spatial_histogram(const Mat& src, Mat& hist, int numPatterns, const Size& window, int overlap) {
-	int width = src.cols;
-	int height = src.rows;
-	vector<Mat> histograms;
-	for(int x=0; x < width - window.width; x+=(window.width-overlap)) {
-		for(int y=0; y < height-window.height; y+=(window.height-overlap)) {
-			Mat cell = Mat(src, Rect(x,y,window.width, window.height));
-			histograms.push_back(histogram(cell, numPatterns));
+	vector<int> xs, ys;
+	grid_cells(src.cols, src.rows, window, overlap, xs, ys);
+	hist.create(1, static_cast<int>(xs.size()*ys.size())*numPatterns, CV_32SC1);
+	hist.setTo(Scalar(0));
+	if(xs.empty() || ys.empty())
+		return;
+	int* h = hist.ptr<int>(0);
+	// Overlapping cells: all cell borders lie on a grid of gcd(step, window)
+	// pixels, so an integral histogram on blocks of that size answers each
+	// cell in O(numPatterns). With a fine grid (a step co-prime to the
+	// window) or many patterns it outgrows counting the cells directly,
+	// which then costs less in both time and memory.
+	Size block(gcd(window.width-overlap, window.width), gcd(window.height-overlap, window.height));
+	int right = xs.back() + window.width;
+	int bottom = ys.back() + window.height;
+	double integralSize = (right/block.width + 1.0) * (bottom/block.height + 1.0) * numPatterns;
+	double directCost = static_cast<double>(xs.size()*ys.size()) * window.area();
+	if(overlap == 0 || integralSize > directCost) {
+		// count every cell on its own
+		for(size_t a=0; a<xs.size(); a++)
+			for(size_t b=0; b<ys.size(); b++)
+				cell_histogram(src, Rect(xs[a], ys[b], window.width, window.height), h + (a*ys.size()+b)*numPatterns);
+		return;
+	}
+	IntegralHistogram integral(src(Rect(0, 0, right, bottom)), numPatterns, block);
+	for(size_t a=0; a<xs.size(); a++)
+		for(size_t b=0; b<ys.size(); b++)
+			integral.cell(Rect(xs[a], ys[b], window.width, window.height), h + (a*ys.size()+b)*numPatterns);
+}
+
+// computes the fused histogram of the plain codes or, if given, the mapped
+// codes, the bands of codes are computed in the codes buffer
+static void spatial_lbp_histogram_(const Mat& src, Mat& hist, int radius, int neighbors, const lbp::Mapping* mapping, int gridx, int gridy, int overlap, Mat& codes) {
+	int numPatterns = mapping ? mapping->numPatterns() : static_cast<int>(std::pow(2.0, static_cast<double>(neighbors)));
+	// geometry of the code image lbp::ELBP would return
+	int width = src.cols - 2*radius;
+	int height = src.rows - 2*radius;
+	Size window(width/gridx, height/gridy);
+	vector<int> xs, ys;
+	grid_cells(width, height, window, overlap, xs, ys);
+	hist.create(1, static_cast<int>(xs.size()*ys.size())*numPatterns, CV_32SC1);
+	hist.setTo(Scalar(0));
+	if(xs.empty() || ys.empty())
+		return;
+	int* h = hist.ptr<int>(0);
+	// only the rows covered by cells are needed
+	int lastRow = ys.back() + window.height;
+	// a band of codes is about 256kB, so it stays in the cache
+	int bandRows = max(1, min(lastRow, (1 << 16) / max(width, 1)));
+	codes.create(bandRows, width, CV_32SC1);
+	for(int r0=0; r0<lastRow; r0+=bandRows) {
+		int rows = min(bandRows, lastRow-r0);
+		Mat band = codes.rowRange(0, rows);
+		if(mapping)
+			lbp::ELBP(src.rowRange(r0, r0+rows+2*radius), band, *mapping, radius, lbp::LBP_BORDER_NONE, CV_32S);
+		else
+			lbp::ELBP(src.rowRange(r0, r0+rows+2*radius), band, radius, neighbors, lbp::LBP_BORDER_NONE, CV_32S);
+		for(int i=0; i<rows; i++) {
+			int y = r0+i;
+			const int* c = band.ptr<int>(i);
+			for(size_t b=0; b<ys.size(); b++) {
+				if(y < ys[b] || y >= ys[b]+window.height)
+					continue;
+				for(size_t a=0; a<xs.size(); a++) {
+					int* cell = h + (a*ys.size()+b)*numPatterns;
+					for(int x=xs[a]; x<xs[a]+window.width; x++)
+						cell[c[x]]++;
+				}
+			}
 		}
 	}
-	hist.create(1, histograms.size()*numPatterns, CV_32SC1);
-	// i know this is a bit lame now... feel free to make this a bit more efficient...
-	for(int histIdx=0; histIdx < histograms.size(); histIdx++) {
-		for(int valIdx = 0; valIdx < numPatterns; valIdx++) {
-			int y = histIdx*numPatterns+valIdx;
-			hist.at<int>(0,y) = histograms[histIdx].at<int>(valIdx);
+}
+
+void lbp::spatial_lbp_histogram(const Mat& src, Mat& hist, int radius, int neighbors, int gridx, int gridy, int overlap) {
+	neighbors = max(min(neighbors,31),1); // same bounds as lbp::ELBP
+	Mat codes;
+	spatial_lbp_histogram_(src, hist, radius, neighbors, NULL, gridx, gridy, overlap, codes);
+}
+
+void lbp::spatial_lbp_histogram(const Mat& src, Mat& hist, const Mapping& mapping, int radius, int gridx, int gridy, int overlap) {
+	Mat codes;
+	spatial_lbp_histogram_(src, hist, radius, mapping.neighbors(), &mapping, gridx, gridy, overlap, codes);
+}
+
+//------------------------------------------------------------------------------
+// batch of regions
+//------------------------------------------------------------------------------
+
+// buffers of a stripe of regions, reused for all of its crops
+struct CropBuffers {
+	Mat crop;
+	Mat codes;
+};
+
+// computes the histograms of the regions of some stripes, every stripe is a
+// contiguous run of regions with its own buffers
+class RegionsInvoker : public ParallelLoopBody {
+public:
+	RegionsInvoker(const Mat& src, const vector<Rect>& rects, Mat& features, const Size& cropSize,
+			int radius, int neighbors, const lbp::Mapping* mapping, int gridx, int gridy, int overlap,
+			vector<CropBuffers>& buffers) :
+		src(src), rects(&rects), features(features), cropSize(cropSize),
+		radius(radius), neighbors(neighbors), mapping(mapping), gridx(gridx), gridy(gridy), overlap(overlap),
+		buffers(&buffers) {}
+
+	void operator()(const Range& range) const {
+		int count = static_cast<int>(rects->size());
+		int stripes = static_cast<int>(buffers->size());
+		for(int s=range.start; s<range.end; s++) {
+			CropBuffers& buf = (*buffers)[s];
+			for(int i=s*count/stripes; i<(s+1)*count/stripes; i++) {
+				Mat hist = features.row(i);
+				Rect rect = (*rects)[i] & Rect(0, 0, src.cols, src.rows);
+				if(rect.width <= 0 || rect.height <= 0) {
+					hist.setTo(Scalar(0));
+					continue;
+				}
+				// buf.crop is only ever the target of resize: were it a
+				// header of src, resize would write into the frame
+				Mat crop = src(rect);
+				if(rect.size() != cropSize) {
+					resize(crop, buf.crop, cropSize);
+					crop = buf.crop;
+				}
+				spatial_lbp_histogram_(crop, hist, radius, neighbors, mapping, gridx, gridy, overlap, buf.codes);
+			}
 		}
 	}
+
+private:
+	Mat src;
+	const vector<Rect>* rects;
+	Mat features;
+	Size cropSize;
+	int radius, neighbors;
+	const lbp::Mapping* mapping;
+	int gridx, gridy, overlap;
+	vector<CropBuffers>* buffers;
+};
+
+static void spatial_lbp_histograms_(const Mat& src, const vector<Rect>& rects, Mat& features, const Size& cropSize, int radius, int neighbors, const lbp::Mapping* mapping, int gridx, int gridy, int overlap) {
+	if(cropSize.width <= 2*radius || cropSize.height <= 2*radius)
+		CV_Error(CV_StsBadArg, format("The crops (%d x %d) must be larger than twice the radius (%d).", cropSize.width, cropSize.height, radius));
+	// the feature length, same geometry as spatial_lbp_histogram_
+	int numPatterns = mapping ? mapping->numPatterns() : static_cast<int>(std::pow(2.0, static_cast<double>(neighbors)));
+	int width = cropSize.width - 2*radius;
+	int height = cropSize.height - 2*radius;
+	vector<int> xs, ys;
+	grid_cells(width, height, Size(width/gridx, height/gridy), overlap, xs, ys);
+	int count = static_cast<int>(rects.size());
+	features.create(count, static_cast<int>(xs.size()*ys.size())*numPatterns, CV_32SC1);
+	if(count == 0)
+		return;
+	// one stripe per thread, so the buffers are allocated once per thread
+	int threads = lbp::getNumThreads() > 0 ? lbp::getNumThreads() : cv::getNumThreads();
+	int stripes = max(1, min(count, threads));
+	vector<CropBuffers> buffers(stripes);
+	RegionsInvoker invoker(src, rects, features, cropSize, radius, neighbors, mapping, gridx, gridy, overlap, buffers);
+	if(stripes == 1)
+		invoker(Range(0, 1));
+	else
+		parallel_for_(Range(0, stripes), invoker, stripes);
+}
+
+void lbp::spatial_lbp_histograms(const Mat& src, const vector<Rect>& rects, Mat& features, const Size& cropSize, int radius, int neighbors, int gridx, int gridy, int overlap) {
+	neighbors = max(min(neighbors,31),1); // same bounds as lbp::ELBP
+	spatial_lbp_histograms_(src, rects, features, cropSize, radius, neighbors, NULL, gridx, gridy, overlap);
+}
+
+void lbp::spatial_lbp_histograms(const Mat& src, const vector<Rect>& rects, Mat& features, const Size& cropSize, const Mapping& mapping, int radius, int gridx, int gridy, int overlap) {
+	spatial_lbp_histograms_(src, rects, features, cropSize, radius, mapping.neighbors(), &mapping, gridx, gridy, overlap);
+}
+
+// concatenates the spatial histograms of the code images
+static void concat_spatial_histograms(const vector<Mat>& maps, const vector<int>& numPatterns, Mat& hist, int gridx, int gridy, int overlap) {
+	vector<Mat> hists(maps.size());
+	int total = 0;
+	for(size_t k=0; k<maps.size(); k++) {
+		lbp::spatial_histogram(maps[k], hists[k], numPatterns[k % numPatterns.size()], gridx, gridy, overlap);
+		total += hists[k].cols;
+	}
+	hist.create(1, total, CV_32SC1);
+	for(size_t k=0, offset=0; k<hists.size(); offset+=hists[k].cols, k++)
+		hists[k].copyTo(hist.colRange(offset, offset+hists[k].cols));
+}
+
+void lbp::spatial_lbp_histogram(const Mat& src, Mat& hist, const vector<int>& radii, const vector<int>& neighbors, int levels, int gridx, int gridy, int overlap) {
+	vector<Mat> maps;
+	ELBP(src, maps, radii, neighbors, levels);
+	vector<int> numPatterns;
+	for(size_t k=0; k<neighbors.size(); k++)
+		numPatterns.push_back(static_cast<int>(std::pow(2.0, static_cast<double>(max(min(neighbors[k],31),1)))));
+	concat_spatial_histograms(maps, numPatterns, hist, gridx, gridy, overlap);
+}
+
+void lbp::spatial_lbp_histogram(const Mat& src, Mat& hist, const vector<int>& radii, const vector<Mapping>& mappings, int levels, int gridx, int gridy, int overlap) {
+	vector<Mat> maps;
+	ELBP(src, maps, radii, mappings, levels);
+	vector<int> numPatterns;
+	for(size_t k=0; k<mappings.size(); k++)
+		numPatterns.push_back(mappings[k].numPatterns());
+	concat_spatial_histograms(maps, numPatterns, hist, gridx, gridy, overlap);
+}
+
+//------------------------------------------------------------------------------
+// batched chi-square distance
+//------------------------------------------------------------------------------
+
+// Scalar chi-square distance of two histograms of length len, bins with
+// h0+h1 == 0 are skipped.
+template <typename _Tp>
+static double chi_square_row_(const _Tp* h0, const _Tp* h1, int len, int start = 0) {
+	double result = 0.0;
+	for(int i=start; i<len; i++) {
+		double a = h0[i] - h1[i];
+		double b = h0[i] + h1[i];
+		if(abs(b) > numeric_limits<double>::epsilon())
+			result += (a*a)/b;
+	}
+	return result;
+}
+
+#ifdef LBP_SSE2
+// Adds (a-b)^2/(a+b) of four bins to the two double accumulators. Bins with
+// a+b == 0 are masked out, the division is exact IEEE, so each term differs
+// from the double one only by float rounding.
+static inline void chi_square_acc_sse2(__m128 a, __m128 b, __m128d& acc0, __m128d& acc1) {
+	const __m128 eps = _mm_set1_ps(static_cast<float>(numeric_limits<double>::epsilon()));
+	const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 d = _mm_sub_ps(a, b);
+	__m128 s = _mm_add_ps(a, b);
+	__m128 mask = _mm_cmpgt_ps(_mm_and_ps(s, absmask), eps);
+	__m128 t = _mm_and_ps(_mm_div_ps(_mm_mul_ps(d, d), s), mask);
+	acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(t));
+	acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(t, t)));
+}
+
+static inline double chi_square_sum_sse2(__m128d acc0, __m128d acc1) {
+	double buf[2];
+	_mm_storeu_pd(buf, _mm_add_pd(acc0, acc1));
+	return buf[0] + buf[1];
+}
+
+static double chi_square_row_32f_sse2(const float* h0, const float* h1, int len) {
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	int i = 0;
+	for(; i <= len - 4; i += 4)
+		chi_square_acc_sse2(_mm_loadu_ps(h0 + i), _mm_loadu_ps(h1 + i), acc0, acc1);
+	return chi_square_sum_sse2(acc0, acc1) + chi_square_row_<float>(h0, h1, len, i);
+}
+
+// counts are exact in float up to 2^24
+static double chi_square_row_32s_sse2(const int* h0, const int* h1, int len) {
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	int i = 0;
+	for(; i <= len - 4; i += 4) {
+		__m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(h0 + i)));
+		__m128 b = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(h1 + i)));
+		chi_square_acc_sse2(a, b, acc0, acc1);
+	}
+	return chi_square_sum_sse2(acc0, acc1) + chi_square_row_<int>(h0, h1, len, i);
+}
+
+static double chi_square_row_16u_sse2(const unsigned short* h0, const unsigned short* h1, int len) {
+	const __m128i z = _mm_setzero_si128();
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	int i = 0;
+	for(; i <= len - 8; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(h0 + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(h1 + i));
+		chi_square_acc_sse2(_mm_cvtepi32_ps(_mm_unpacklo_epi16(a, z)), _mm_cvtepi32_ps(_mm_unpacklo_epi16(b, z)), acc0, acc1);
+		chi_square_acc_sse2(_mm_cvtepi32_ps(_mm_unpackhi_epi16(a, z)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(b, z)), acc0, acc1);
+	}
+	return chi_square_sum_sse2(acc0, acc1) + chi_square_row_<unsigned short>(h0, h1, len, i);
+}
+#endif
+
+template <typename _Tp>
+static double chi_square_row(const _Tp* h0, const _Tp* h1, int len) {
+	return chi_square_row_<_Tp>(h0, h1, len);
+}
+
+#ifdef LBP_SSE2
+template <>
+double chi_square_row<float>(const float* h0, const float* h1, int len) {
+	return lbp::haveSSE2() ? chi_square_row_32f_sse2(h0, h1, len) : chi_square_row_<float>(h0, h1, len);
+}
+
+template <>
+double chi_square_row<int>(const int* h0, const int* h1, int len) {
+	return lbp::haveSSE2() ? chi_square_row_32s_sse2(h0, h1, len) : chi_square_row_<int>(h0, h1, len);
+}
+
+template <>
+double chi_square_row<unsigned short>(const unsigned short* h0, const unsigned short* h1, int len) {
+	return lbp::haveSSE2() ? chi_square_row_16u_sse2(h0, h1, len) : chi_square_row_<unsigned short>(h0, h1, len);
+}
+#endif
+
+// scores the gallery rows of a range against the query
+template <typename _Tp>
+class ChiSquareInvoker : public ParallelLoopBody {
+public:
+	ChiSquareInvoker(const Mat& query, const Mat& gallery, Mat& distances) :
+		query(query), gallery(gallery), distances(distances) {}
+
+	void operator()(const Range& range) const {
+		const _Tp* q = query.ptr<_Tp>(0);
+		double* d = const_cast<double*>(distances.ptr<double>(0));
+		for(int i=range.start; i<range.end; i++)
+			d[i] = chi_square_row<_Tp>(q, gallery.ptr<_Tp>(i), gallery.cols);
+	}
+
+private:
+	Mat query;
+	Mat gallery;
+	Mat distances;
+};
+
+template <typename _Tp>
+static void chi_square_distances_(const Mat& query, const Mat& gallery, Mat& distances) {
+	// a few hundred rows per stripe keep the scheduling overhead small
+	int stripes = max(1, gallery.rows / 256);
+	parallel_for_(Range(0, gallery.rows), ChiSquareInvoker<_Tp>(query, gallery, distances), stripes);
+}
+
+void lbp::chi_square_distances(const Mat& query, const Mat& gallery, Mat& distances) {
+	if(query.type() != gallery.type())
+		CV_Error(CV_StsBadArg, "Histograms must be of equal type.");
+	if(query.rows != 1 || query.cols != gallery.cols)
+		CV_Error(CV_StsBadArg, format("The query must be a 1 x %d histogram, but was %d x %d.", gallery.cols, query.rows, query.cols));
+	distances.create(1, gallery.rows, CV_64FC1);
+	switch(gallery.type()) {
+		case CV_8SC1: chi_square_distances_<char>(query, gallery, distances); break;
+		case CV_8UC1: chi_square_distances_<unsigned char>(query, gallery, distances); break;
+		case CV_16SC1: chi_square_distances_<short>(query, gallery, distances); break;
+		case CV_16UC1: chi_square_distances_<unsigned short>(query, gallery, distances); break;
+		case CV_32SC1: chi_square_distances_<int>(query, gallery, distances); break;
+		case CV_32FC1: chi_square_distances_<float>(query, gallery, distances); break;
+		case CV_64FC1: chi_square_distances_<double>(query, gallery, distances); break;
+		default: CV_Error(CV_StsUnsupportedFormat, "Unsupported histogram type.");
+	}
 }
 
 // wrappers
@@ -68,7 +525,37 @@ double lbp::chi_square(const Mat& histogram0, const Mat& histogram1) {
 		case CV_16SC1: return chi_square_<short>(histogram0, histogram1); break;
 		case CV_16UC1: return chi_square_<unsigned short>(histogram0,histogram1); break;
 		case CV_32SC1: return chi_square_<int>(histogram0,histogram1); break;
+		case CV_32FC1: return chi_square_<float>(histogram0,histogram1); break;
+		case CV_64FC1: return chi_square_<double>(histogram0,histogram1); break;
 	}
+	CV_Error(CV_StsUnsupportedFormat, "Unsupported histogram type.");
+	return 0.0;
+}
+
+void lbp::chi_square(const Mat& query, const Mat& gallery, Mat& distances) {
+	chi_square_distances(query, gallery, distances);
+}
+
+// comparator for the indices of the k nearest gallery rows
+struct DistanceLess {
+	const double* d;
+	DistanceLess(const double* d) : d(d) {}
+	bool operator()(int a, int b) const { return (d[a] < d[b]) || (d[a] == d[b] && a < b); }
+};
+
+void lbp::chi_square_nearest(const Mat& query, const Mat& gallery, int k, vector<int>& indices, vector<double>& distances) {
+	Mat all;
+	chi_square_distances(query, gallery, all);
+	const double* d = all.ptr<double>(0);
+	k = max(min(k, gallery.rows), 0);
+	vector<int> order(gallery.rows);
+	for(int i=0; i<gallery.rows; i++)
+		order[i] = i;
+	std::partial_sort(order.begin(), order.begin()+k, order.end(), DistanceLess(d));
+	indices.assign(order.begin(), order.begin()+k);
+	distances.resize(k);
+	for(int i=0; i<k; i++)
+		distances[i] = d[indices[i]];
 }
 
 void lbp::spatial_histogram(const Mat& src, Mat& dst, int numPatterns, int gridx, int gridy, int overlap) {
@@ -94,6 +581,19 @@ Mat lbp::spatial_histogram(const Mat& src, int numPatterns, const Size& window,
 
 Mat lbp::spatial_histogram(const Mat& src, int numPatterns, int gridx, int gridy, int overlap) {
 	Mat hist;
-	spatial_histogram(src, hist, numPatterns, gridx, gridy);
+	spatial_histogram(src, hist, numPatterns, gridx, gridy, overlap);
+	return hist;
+}
+
+
+Mat lbp::spatial_lbp_histogram(const Mat& src, int radius, int neighbors, int gridx, int gridy, int overlap) {
+	Mat hist;
+	spatial_lbp_histogram(src, hist, radius, neighbors, gridx, gridy, overlap);
+	return hist;
+}
+
+Mat lbp::spatial_lbp_histogram(const Mat& src, const Mapping& mapping, int radius, int gridx, int gridy, int overlap) {
+	Mat hist;
+	spatial_lbp_histogram(src, hist, mapping, radius, gridx, gridy, overlap);
 	return hist;
 }
@@ -6,30 +6,89 @@
 
 #include <cv.h>
 #include <limits>
+#include "lbp.hpp"
 
 using namespace cv;
 using namespace std;
 
 namespace lbp {
 
+// Integral histogram of a code image, computed on a grid of blocks. The
+// histogram of any rectangle aligned to the blocks is answered in
+// O(numPatterns), no matter how large it is. Memory is
+// (rows/block.height+1) * (cols/block.width+1) * numPatterns integers, so
+// use the largest block that still aligns with the cells you query.
+class IntegralHistogram {
+public:
+	IntegralHistogram() : _numPatterns(0) {}
+	IntegralHistogram(const Mat& src, int numPatterns, const Size& block = Size(1,1)) {
+		compute(src, numPatterns, block);
+	}
+	//! computes the integral histogram of the codes in src
+	void compute(const Mat& src, int numPatterns, const Size& block = Size(1,1));
+	//! writes the histogram of rect (in pixels, aligned to the blocks) to hist
+	void cell(const Rect& rect, int* hist) const;
+	int numPatterns() const { return _numPatterns; }
+	Size block() const { return _block; }
+
+private:
+	Mat _sum; // (blocks in y + 1) x ((blocks in x + 1) * numPatterns)
+	Size _block;
+	int _numPatterns;
+};
+
 // templated functions
 template <typename _Tp>
 void histogram_(const Mat& src, Mat& hist, int numPatterns);
 
+template <typename _Tp>
+void integral_histogram_(const Mat& src, Mat& sum, int numPatterns, const Size& block);
+
 template <typename _Tp>
 double chi_square_(const Mat& histogram0, const Mat& histogram1);
 
 // non-templated functions
 void spatial_histogram(const Mat& src, Mat& spatialhist, int numPatterns, const Size& window, int overlap=0);
 
+// fused lbp::ELBP and lbp::spatial_histogram, which computes the codes in
+// cache-sized bands and never materializes the full code image
+void spatial_lbp_histogram(const Mat& src, Mat& spatialhist, int radius=1, int neighbors=8, int gridx=8, int gridy=8, int overlap=0);
+// same with mapped codes, the histograms have mapping.numPatterns() bins
+void spatial_lbp_histogram(const Mat& src, Mat& spatialhist, const Mapping& mapping, int radius=1, int gridx=8, int gridy=8, int overlap=0);
+// Fused spatial histograms of many regions of one image, e.g. the faces
+// detected in a frame. Every rect is clipped to src and resized to cropSize,
+// row i of features (rects.size() x bins, CV_32SC1) gets the histogram of
+// rects[i], a rect outside of src gets zeros. The regions are split into one
+// stripe per thread and each stripe reuses its crop and code buffers, so
+// features is the only allocation that scales with the number of regions
+// (and none if it already has the right size).
+void spatial_lbp_histograms(const Mat& src, const vector<Rect>& rects, Mat& features, const Size& cropSize, int radius=1, int neighbors=8, int gridx=8, int gridy=8, int overlap=0);
+void spatial_lbp_histograms(const Mat& src, const vector<Rect>& rects, Mat& features, const Size& cropSize, const Mapping& mapping, int radius=1, int gridx=8, int gridy=8, int overlap=0);
+// concatenated spatial histograms of the code images of the multi-scale
+// lbp::ELBP, each divided into a gridx x gridy grid
+void spatial_lbp_histogram(const Mat& src, Mat& spatialhist, const vector<int>& radii, const vector<int>& neighbors, int levels=1, int gridx=8, int gridy=8, int overlap=0);
+void spatial_lbp_histogram(const Mat& src, Mat& spatialhist, const vector<int>& radii, const vector<Mapping>& mappings, int levels=1, int gridx=8, int gridy=8, int overlap=0);
+
+// Chi-square distances of a 1 x N query histogram to every row of a M x N
+// gallery of the same type, returned as 1 x M CV_64FC1. The rows are scored
+// in parallel; CV_32SC1, CV_32FC1 and CV_16UC1 histograms use a vectorized
+// kernel, which computes each term in float (counts must be below 2^24)
+// and sums in double.
+void chi_square_distances(const Mat& query, const Mat& gallery, Mat& distances);
+// the k gallery rows nearest to the query, sorted by ascending distance
+void chi_square_nearest(const Mat& query, const Mat& gallery, int k, vector<int>& indices, vector<double>& distances);
+
 // wrapper functions
 void spatial_histogram(const Mat& src, Mat& spatialhist, int numPatterns, int gridx=8, int gridy=8, int overlap=0);
 void histogram(const Mat& src, Mat& hist, int numPatterns);
 double chi_square(const Mat& histogram0, const Mat& histogram1);
+void chi_square(const Mat& query, const Mat& gallery, Mat& distances);
 
 // Mat return type functions
 Mat histogram(const Mat& src, int numPatterns);
 Mat spatial_histogram(const Mat& src, int numPatterns, const Size& window, int overlap=0);
 Mat spatial_histogram(const Mat& src, int numPatterns, int gridx=8, int gridy=8, int overlap=0);
+Mat spatial_lbp_histogram(const Mat& src, int radius=1, int neighbors=8, int gridx=8, int gridy=8, int overlap=0);
+Mat spatial_lbp_histogram(const Mat& src, const Mapping& mapping, int radius=1, int gridx=8, int gridy=8, int overlap=0);
 }
 #endif
@@ -1,108 +1,1204 @@
 #include "lbp.hpp"
+#include "simd.hpp"
+#include <map>
+#include <climits>
 
 using namespace cv;
+#ifdef LBP_SSE2
+using lbp::haveSSE2;
+#endif
+#ifdef LBP_AVX2
+using lbp::haveAVX2;
+#endif
 
+//------------------------------------------------------------------------------
+// parallel execution
+//------------------------------------------------------------------------------
+static int lbp_num_threads = 0;
+static int lbp_grain_size = 16;
+
+void lbp::setNumThreads(int nthreads) { lbp_num_threads = max(nthreads, 0); }
+int lbp::getNumThreads() { return lbp_num_threads; }
+void lbp::setGrainSize(int rows) { lbp_grain_size = max(rows, 1); }
+int lbp::getGrainSize() { return lbp_grain_size; }
+
+static bool lbp_fixed_point = false;
+
+void lbp::setUseFixedPoint(bool enabled) { lbp_fixed_point = enabled; }
+bool lbp::useFixedPoint() { return lbp_fixed_point; }
+
+// parameters of the row kernels
+struct KernelArgs {
+	const lbp::SamplingPlan* plan;
+	const int* table; // lookup table applied to the codes, if not NULL
+
+	KernelArgs(const lbp::SamplingPlan* plan = NULL, const int* table = NULL) :
+		plan(plan), table(table) {}
+};
+
+// computes the output rows [begin, end) of an operator
+typedef void (*RowsFunc)(const Mat& src, Mat& dst, const KernelArgs& args, int begin, int end);
+
+class RowsInvoker : public ParallelLoopBody {
+public:
+	RowsInvoker(RowsFunc func, const Mat& src, Mat& dst, const KernelArgs& args) :
+		func(func), src(src), dst(dst), args(args) {}
+
+	void operator()(const Range& range) const {
+		Mat band = dst;
+		func(src, band, args, range.start, range.end);
+	}
+
+private:
+	RowsFunc func;
+	Mat src;
+	Mat dst;
+	KernelArgs args;
+};
+
+// Splits dst into bands of at least lbp::getGrainSize() rows and computes
+// them in parallel. Every band reads its halo of radius rows straight from
+// the shared source, so the bands are independent and the result is the
+// same as the serial one. With lbp::setNumThreads(n), n > 1, there are at
+// most n bands in flight.
+static int band_count(int rows) {
+	if(lbp_num_threads == 1)
+		return 1;
+	int bands = max(rows / lbp_grain_size, 1);
+	if(lbp_num_threads > 1)
+		bands = min(bands, lbp_num_threads);
+	return bands;
+}
+
+static void parallel_rows(RowsFunc func, const Mat& src, Mat& dst, const KernelArgs& args) {
+	int bands = band_count(dst.rows);
+	if(bands <= 1) {
+		func(src, dst, args, 0, dst.rows);
+		return;
+	}
+	parallel_for_(Range(0, dst.rows), RowsInvoker(func, src, dst, args), bands);
+}
+
+//------------------------------------------------------------------------------
+// lbp::OLBP_
+//------------------------------------------------------------------------------
+
+// The vectorized row kernels below compute the codes for as many columns of
+// an output row as they can and return the number of columns processed. The
+// scalar loop in olbp_rows_ takes care of the remainder (and of all types
+// without a vector kernel), so every path yields exactly the same codes.
 template <typename _Tp>
-void lbp::OLBP_(const Mat& src, Mat& dst) {
-	dst = Mat::zeros(src.rows-2, src.cols-2, CV_8UC1);
-	for(int i=1;i<src.rows-1;i++) {
-		for(int j=1;j<src.cols-1;j++) {
-			_Tp center = src.at<_Tp>(i,j);
+static inline int olbp_row_simd_(const _Tp*, const _Tp*, const _Tp*, unsigned char*, int) {
+	return 0;
+}
+
+#ifdef LBP_SSE2
+// sets bit in code, where neighbor > center (both biased to signed compares)
+static inline __m128i olbp_bit_sse2(__m128i code, __m128i neighbor, __m128i center, int bit) {
+	__m128i mask = _mm_cmpgt_epi8(neighbor, center);
+	return _mm_or_si128(code, _mm_and_si128(mask, _mm_set1_epi8(static_cast<char>(1 << bit))));
+}
+
+// 16 codes per iteration, bias 0x80 turns the unsigned compare into a signed one
+static int olbp_row_8u_sse2(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int width, unsigned char bias) {
+	const __m128i b = _mm_set1_epi8(static_cast<char>(bias));
+	int j = 0;
+	for(; j <= width - 16; j += 16) {
+		__m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p1 + j + 1)), b);
+		__m128i code = _mm_setzero_si128();
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p0 + j)), b), c, 7);
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p0 + j + 1)), b), c, 6);
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p0 + j + 2)), b), c, 5);
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p1 + j + 2)), b), c, 4);
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p2 + j + 2)), b), c, 3);
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p2 + j + 1)), b), c, 2);
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p2 + j)), b), c, 1);
+		code = olbp_bit_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p1 + j)), b), c, 0);
+		_mm_storeu_si128((__m128i*)(d + j), code);
+	}
+	return j;
+}
+
+static inline __m128i olbp_bit16_sse2(__m128i code, __m128i neighbor, __m128i center, int bit) {
+	__m128i mask = _mm_cmpgt_epi16(neighbor, center);
+	return _mm_or_si128(code, _mm_and_si128(mask, _mm_set1_epi16(static_cast<short>(1 << bit))));
+}
+
+// 8 codes per iteration, bias 0x8000 turns the unsigned compare into a signed one
+static int olbp_row_16u_sse2(const unsigned short* p0, const unsigned short* p1, const unsigned short* p2, unsigned char* d, int width, unsigned short bias) {
+	const __m128i b = _mm_set1_epi16(static_cast<short>(bias));
+	int j = 0;
+	for(; j <= width - 8; j += 8) {
+		__m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p1 + j + 1)), b);
+		__m128i code = _mm_setzero_si128();
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p0 + j)), b), c, 7);
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p0 + j + 1)), b), c, 6);
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p0 + j + 2)), b), c, 5);
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p1 + j + 2)), b), c, 4);
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p2 + j + 2)), b), c, 3);
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p2 + j + 1)), b), c, 2);
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p2 + j)), b), c, 1);
+		code = olbp_bit16_sse2(code, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p1 + j)), b), c, 0);
+		_mm_storel_epi64((__m128i*)(d + j), _mm_packus_epi16(code, code));
+	}
+	return j;
+}
+#endif
+
+#ifdef LBP_AVX2
+__attribute__((target("avx2")))
+static inline __m256i olbp_bit_avx2(__m256i code, __m256i neighbor, __m256i center, int bit) {
+	__m256i mask = _mm256_cmpgt_epi8(neighbor, center);
+	return _mm256_or_si256(code, _mm256_and_si256(mask, _mm256_set1_epi8(static_cast<char>(1 << bit))));
+}
+
+// 32 codes per iteration, same scheme as olbp_row_8u_sse2
+__attribute__((target("avx2")))
+static int olbp_row_8u_avx2(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int width, unsigned char bias) {
+	const __m256i b = _mm256_set1_epi8(static_cast<char>(bias));
+	int j = 0;
+	for(; j <= width - 32; j += 32) {
+		__m256i c = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p1 + j + 1)), b);
+		__m256i code = _mm256_setzero_si256();
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p0 + j)), b), c, 7);
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p0 + j + 1)), b), c, 6);
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p0 + j + 2)), b), c, 5);
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p1 + j + 2)), b), c, 4);
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p2 + j + 2)), b), c, 3);
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p2 + j + 1)), b), c, 2);
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p2 + j)), b), c, 1);
+		code = olbp_bit_avx2(code, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p1 + j)), b), c, 0);
+		_mm256_storeu_si256((__m256i*)(d + j), code);
+	}
+	return j;
+}
+#endif
+
+#ifdef LBP_NEON
+static inline uint8x16_t olbp_bit_neon(uint8x16_t code, uint8x16_t mask, int bit) {
+	return vorrq_u8(code, vandq_u8(mask, vdupq_n_u8(static_cast<unsigned char>(1 << bit))));
+}
+
+static int olbp_row_8u_neon(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int width) {
+	int j = 0;
+	for(; j <= width - 16; j += 16) {
+		uint8x16_t c = vld1q_u8(p1 + j + 1);
+		uint8x16_t code = vdupq_n_u8(0);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p0 + j), c), 7);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p0 + j + 1), c), 6);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p0 + j + 2), c), 5);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p1 + j + 2), c), 4);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p2 + j + 2), c), 3);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p2 + j + 1), c), 2);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p2 + j), c), 1);
+		code = olbp_bit_neon(code, vcgtq_u8(vld1q_u8(p1 + j), c), 0);
+		vst1q_u8(d + j, code);
+	}
+	return j;
+}
+
+static int olbp_row_8s_neon(const signed char* p0, const signed char* p1, const signed char* p2, unsigned char* d, int width) {
+	int j = 0;
+	for(; j <= width - 16; j += 16) {
+		int8x16_t c = vld1q_s8(p1 + j + 1);
+		uint8x16_t code = vdupq_n_u8(0);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p0 + j), c), 7);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p0 + j + 1), c), 6);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p0 + j + 2), c), 5);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p1 + j + 2), c), 4);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p2 + j + 2), c), 3);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p2 + j + 1), c), 2);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p2 + j), c), 1);
+		code = olbp_bit_neon(code, vcgtq_s8(vld1q_s8(p1 + j), c), 0);
+		vst1q_u8(d + j, code);
+	}
+	return j;
+}
+#endif
+
+template <>
+inline int olbp_row_simd_<unsigned char>(const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, unsigned char* d, int width) {
+#ifdef LBP_AVX2
+	if(haveAVX2())
+		return olbp_row_8u_avx2(p0, p1, p2, d, width, 0x80);
+#endif
+#ifdef LBP_SSE2
+	if(haveSSE2())
+		return olbp_row_8u_sse2(p0, p1, p2, d, width, 0x80);
+#endif
+#ifdef LBP_NEON
+	return olbp_row_8u_neon(p0, p1, p2, d, width);
+#endif
+	return 0;
+}
+
+// plain char is signed or unsigned depending on the platform, so is the compare
+template <>
+inline int olbp_row_simd_<char>(const char* p0, const char* p1, const char* p2, unsigned char* d, int width) {
+	const unsigned char bias = std::numeric_limits<char>::is_signed ? 0x00 : 0x80;
+	const unsigned char* u0 = reinterpret_cast<const unsigned char*>(p0);
+	const unsigned char* u1 = reinterpret_cast<const unsigned char*>(p1);
+	const unsigned char* u2 = reinterpret_cast<const unsigned char*>(p2);
+#ifdef LBP_AVX2
+	if(haveAVX2())
+		return olbp_row_8u_avx2(u0, u1, u2, d, width, bias);
+#endif
+#ifdef LBP_SSE2
+	if(haveSSE2())
+		return olbp_row_8u_sse2(u0, u1, u2, d, width, bias);
+#endif
+#ifdef LBP_NEON
+	if(std::numeric_limits<char>::is_signed)
+		return olbp_row_8s_neon(reinterpret_cast<const signed char*>(p0), reinterpret_cast<const signed char*>(p1), reinterpret_cast<const signed char*>(p2), d, width);
+	return olbp_row_8u_neon(u0, u1, u2, d, width);
+#endif
+	(void)bias; (void)u0; (void)u1; (void)u2;
+	return 0;
+}
+
+template <>
+inline int olbp_row_simd_<unsigned short>(const unsigned short* p0, const unsigned short* p1, const unsigned short* p2, unsigned char* d, int width) {
+#ifdef LBP_SSE2
+	if(haveSSE2())
+		return olbp_row_16u_sse2(p0, p1, p2, d, width, 0x8000);
+#endif
+	return 0;
+}
+
+template <>
+inline int olbp_row_simd_<short>(const short* p0, const short* p1, const short* p2, unsigned char* d, int width) {
+#ifdef LBP_SSE2
+	if(haveSSE2())
+		return olbp_row_16u_sse2(reinterpret_cast<const unsigned short*>(p0), reinterpret_cast<const unsigned short*>(p1), reinterpret_cast<const unsigned short*>(p2), d, width, 0x0000);
+#endif
+	return 0;
+}
+
+// computes the output rows [begin, end) of the original lbp operator
+template <typename _Tp>
+static void olbp_rows_(const Mat& src, Mat& dst, const KernelArgs&, int begin, int end) {
+	for(int i=begin;i<end;i++) {
+		const _Tp* p0 = src.ptr<_Tp>(i);
+		const _Tp* p1 = src.ptr<_Tp>(i+1);
+		const _Tp* p2 = src.ptr<_Tp>(i+2);
+		unsigned char* d = dst.ptr<unsigned char>(i);
+		int j = olbp_row_simd_<_Tp>(p0, p1, p2, d, dst.cols);
+		for(;j<dst.cols;j++) {
+			_Tp center = p1[j+1];
 			unsigned char code = 0;
-			code |= (src.at<_Tp>(i-1,j-1) > center) << 7;
-			code |= (src.at<_Tp>(i-1,j) > center) << 6;
-			code |= (src.at<_Tp>(i-1,j+1) > center) << 5;
-			code |= (src.at<_Tp>(i,j+1) > center) << 4;
-			code |= (src.at<_Tp>(i+1,j+1) > center) << 3;
-			code |= (src.at<_Tp>(i+1,j) > center) << 2;
-			code |= (src.at<_Tp>(i+1,j-1) > center) << 1;
-			code |= (src.at<_Tp>(i,j-1) > center) << 0;
-			dst.at<unsigned char>(i-1,j-1) = code;
+			code |= (p0[j] > center) << 7;
+			code |= (p0[j+1] > center) << 6;
+			code |= (p0[j+2] > center) << 5;
+			code |= (p1[j+2] > center) << 4;
+			code |= (p2[j+2] > center) << 3;
+			code |= (p2[j+1] > center) << 2;
+			code |= (p2[j] > center) << 1;
+			code |= (p1[j] > center) << 0;
+			d[j] = code;
 		}
 	}
 }
 
 template <typename _Tp>
-void lbp::ELBP_(const Mat& src, Mat& dst, int radius, int neighbors) {
-	neighbors = max(min(neighbors,31),1); // set bounds...
-	// Note: alternatively you can switch to the new OpenCV Mat_
-	// type system to define an unsigned int matrix... I am probably
-	// mistaken here, but I didn't see an unsigned int representation
-	// in OpenCV's classic typesystem...
-	dst = Mat::zeros(src.rows-2*radius, src.cols-2*radius, CV_32SC1);
+void lbp::OLBP_(const Mat& src, Mat& dst) {
+	// every code is written, so there's no need to zero the result
+	dst.create(src.rows-2, src.cols-2, CV_8UC1);
+	parallel_rows(olbp_rows_<_Tp>, src, dst, KernelArgs());
+}
+
+//------------------------------------------------------------------------------
+// lbp::SamplingPlan
+//------------------------------------------------------------------------------
+
+// Rounds the bilinear weights of a sample to Q fractional bits. The rounding
+// error is given to the largest weight, so the weights sum to exactly 2^Q
+// and a flat neighborhood interpolates to exactly its value.
+static void quantize_weights(const lbp::SamplingPlan::Sample& s, int Q, unsigned int w[4]) {
+	const float ws[4] = { s.w1, s.w2, s.w3, s.w4 };
+	int sum = 0, largest = 0;
+	for(int k=0; k<4; k++) {
+		w[k] = static_cast<unsigned int>(cvRound(ws[k] * (1 << Q)));
+		sum += w[k];
+		if(ws[k] > ws[largest])
+			largest = k;
+	}
+	w[largest] += (1 << Q) - sum;
+}
+
+lbp::SamplingPlan::SamplingPlan(int radius, int neighbors) :
+	radius(radius),
+	neighbors(neighbors),
+	samples(neighbors),
+	q8(4*neighbors),
+	q15(4*neighbors)
+{
 	for(int n=0; n<neighbors; n++) {
+		Sample& s = samples[n];
 		// sample points
 		float x = static_cast<float>(radius) * cos(2.0*M_PI*n/static_cast<float>(neighbors));
 		float y = static_cast<float>(radius) * -sin(2.0*M_PI*n/static_cast<float>(neighbors));
 		// relative indices
-		int fx = static_cast<int>(floor(x));
-		int fy = static_cast<int>(floor(y));
-		int cx = static_cast<int>(ceil(x));
-		int cy = static_cast<int>(ceil(y));
+		s.fx = static_cast<int>(floor(x));
+		s.fy = static_cast<int>(floor(y));
+		s.cx = static_cast<int>(ceil(x));
+		s.cy = static_cast<int>(ceil(y));
 		// fractional part
-		float ty = y - fy;
-		float tx = x - fx;
+		float ty = y - s.fy;
+		float tx = x - s.fx;
 		// set interpolation weights
-		float w1 = (1 - tx) * (1 - ty);
-		float w2 =      tx  * (1 - ty);
-		float w3 = (1 - tx) *      ty;
-		float w4 =      tx  *      ty;
-		// iterate through your data
-		for(int i=radius; i < src.rows-radius;i++) {
-			for(int j=radius;j < src.cols-radius;j++) {
-				float t = w1*src.at<_Tp>(i+fy,j+fx) + w2*src.at<_Tp>(i+fy,j+cx) + w3*src.at<_Tp>(i+cy,j+fx) + w4*src.at<_Tp>(i+cy,j+cx);
-				// we are dealing with floating point precision, so add some little tolerance
-				dst.at<unsigned int>(i-radius,j-radius) += ((t > src.at<_Tp>(i,j)) && (abs(t-src.at<_Tp>(i,j)) > std::numeric_limits<float>::epsilon())) << n;
+		s.w1 = (1 - tx) * (1 - ty);
+		s.w2 =      tx  * (1 - ty);
+		s.w3 = (1 - tx) *      ty;
+		s.w4 =      tx  *      ty;
+		// sampling points on the grid don't need an interpolation
+		const float w[4] = { s.w1, s.w2, s.w3, s.w4 };
+		const int ox[4] = { s.fx, s.cx, s.fx, s.cx };
+		const int oy[4] = { s.fy, s.fy, s.cy, s.cy };
+		s.exact = -1;
+		s.ex = s.ey = 0;
+		for(int k=0; k<4; k++) {
+			if(w[k] == 1.0f && w[(k+1)%4] == 0.0f && w[(k+2)%4] == 0.0f && w[(k+3)%4] == 0.0f) {
+				s.exact = k;
+				s.ex = ox[k];
+				s.ey = oy[k];
+			}
+		}
+		quantize_weights(s, 8, &q8[4*n]);
+		quantize_weights(s, 15, &q15[4*n]);
+	}
+}
+
+const lbp::SamplingPlan& lbp::SamplingPlan::get(int radius, int neighbors) {
+	static Mutex mutex;
+	static std::map<std::pair<int,int>, SamplingPlan> cache;
+	AutoLock lock(mutex);
+	std::pair<int,int> key(radius, neighbors);
+	std::map<std::pair<int,int>, SamplingPlan>::iterator it = cache.find(key);
+	if(it == cache.end())
+		it = cache.insert(std::make_pair(key, SamplingPlan(radius, neighbors))).first;
+	return it->second;
+}
+
+//------------------------------------------------------------------------------
+// lbp::Mapping
+//------------------------------------------------------------------------------
+
+// rotates the lower neighbors bits of code one position to the left
+static inline int rotate_left(int code, int neighbors) {
+	return ((code << 1) | (code >> (neighbors-1))) & ((1 << neighbors) - 1);
+}
+
+static inline int bit_count(int code) {
+	int count = 0;
+	for(; code; code &= code-1)
+		count++;
+	return count;
+}
+
+// number of 0/1 transitions in the circular pattern
+static inline int transitions(int code, int neighbors) {
+	return bit_count(code ^ rotate_left(code, neighbors));
+}
+
+// Computes the table the same way as getmapping.m of the original authors,
+// so the bin order is identical: uniform patterns and rotation invariant
+// classes are numbered in the order they appear, non-uniform patterns go to
+// the last bin.
+static Mat create_mapping(int neighbors, int type, int& numPatterns) {
+	const int size = 1 << neighbors;
+	Mat table(1, size, CV_32SC1);
+	int* t = table.ptr<int>(0);
+	switch(type) {
+	case lbp::LBP_MAPPING_NONE:
+		for(int i=0; i<size; i++)
+			t[i] = i;
+		numPatterns = size;
+		break;
+	case lbp::LBP_MAPPING_U2: {
+		numPatterns = neighbors*(neighbors-1) + 3;
+		int index = 0;
+		for(int i=0; i<size; i++)
+			t[i] = (transitions(i, neighbors) <= 2) ? index++ : numPatterns-1;
+		break;
+	}
+	case lbp::LBP_MAPPING_RI: {
+		vector<int> classes(size, -1);
+		numPatterns = 0;
+		for(int i=0; i<size; i++) {
+			// the smallest rotation identifies the class
+			int rm = i;
+			int r = i;
+			for(int j=1; j<neighbors; j++) {
+				r = rotate_left(r, neighbors);
+				rm = min(rm, r);
 			}
+			if(classes[rm] < 0)
+				classes[rm] = numPatterns++;
+			t[i] = classes[rm];
 		}
+		break;
 	}
+	case lbp::LBP_MAPPING_RIU2:
+		numPatterns = neighbors + 2;
+		for(int i=0; i<size; i++)
+			t[i] = (transitions(i, neighbors) <= 2) ? bit_count(i) : neighbors+1;
+		break;
+	default:
+		CV_Error(CV_StsBadArg, format("Unknown mapping type %d.", type));
+	}
+	return table;
+}
+
+lbp::Mapping::Mapping(int neighbors, int type) :
+	_neighbors(neighbors),
+	_type(type),
+	_numPatterns(0)
+{
+	if(neighbors < 1 || neighbors > 24) {
+		string error_message = format("Mappings are only supported for 1 to 24 neighbors, but %d were given.", neighbors);
+		CV_Error(CV_StsBadArg, error_message);
+	}
+	// tables are shared between all mappings of the same kind
+	static Mutex mutex;
+	static std::map<std::pair<int,int>, std::pair<Mat,int> > cache;
+	AutoLock lock(mutex);
+	std::pair<int,int> key(neighbors, type);
+	std::map<std::pair<int,int>, std::pair<Mat,int> >::iterator it = cache.find(key);
+	if(it == cache.end()) {
+		int numPatterns = 0;
+		Mat table = create_mapping(neighbors, type, numPatterns);
+		it = cache.insert(std::make_pair(key, std::make_pair(table, numPatterns))).first;
+	}
+	_table = it->second.first;
+	_numPatterns = it->second.second;
 }
 
 template <typename _Tp>
-void lbp::VARLBP_(const Mat& src, Mat& dst, int radius, int neighbors) {
-	max(min(neighbors,31),1); // set bounds
-	dst = Mat::zeros(src.rows-2*radius, src.cols-2*radius, CV_32FC1); //! result
-	// allocate some memory for temporary on-line variance calculations
-	Mat _mean = Mat::zeros(src.rows, src.cols, CV_32FC1);
-	Mat _delta = Mat::zeros(src.rows, src.cols, CV_32FC1);
-	Mat _m2 = Mat::zeros(src.rows, src.cols, CV_32FC1);
+static void apply_mapping_(const Mat& src, Mat& dst, const int* table) {
+	dst.create(src.rows, src.cols, CV_32SC1);
+	for(int i=0; i<src.rows; i++) {
+		const _Tp* c = src.ptr<_Tp>(i);
+		int* d = dst.ptr<int>(i);
+		for(int j=0; j<src.cols; j++) {
+			int code = c[j];
+			d[j] = table[code];
+		}
+	}
+}
+
+void lbp::apply_mapping(const Mat& src, Mat& dst, const Mapping& mapping) {
+	const int* table = mapping.table().ptr<int>(0);
+	switch(src.type()) {
+		case CV_8UC1: apply_mapping_<unsigned char>(src, dst, table); break;
+		case CV_16UC1: apply_mapping_<unsigned short>(src, dst, table); break;
+		case CV_32SC1: apply_mapping_<int>(src, dst, table); break;
+		default: CV_Error(CV_StsUnsupportedFormat, "Codes must be given as CV_8UC1, CV_16UC1 or CV_32SC1.");
+	}
+}
+
+//------------------------------------------------------------------------------
+// lbp::ELBP_
+//------------------------------------------------------------------------------
+
+// Row pointers of the four interpolation points of every neighbor. Integer
+// images skip the interpolation of sampling points on the grid: a weight of 1
+// and three weights of 0 yield the exact same float as the plain value.
+template <typename _Tp>
+struct SampleRows {
+	const _Tp* p1[32];
+	const _Tp* p2[32];
+	const _Tp* p3[32];
+	const _Tp* p4[32];
+	bool exact[32];
+
+	// i and j are the source coordinates of the first center in the row
+	void set(const Mat& src, const lbp::SamplingPlan& plan, int i, int j) {
+		set(src, &plan.samples[0], plan.neighbors, i, j);
+	}
+
+	void set(const Mat& src, const lbp::SamplingPlan::Sample* samples, int neighbors, int i, int j) {
+		for(int n=0; n<neighbors; n++) {
+			const lbp::SamplingPlan::Sample& s = samples[n];
+			exact[n] = std::numeric_limits<_Tp>::is_integer && (s.exact >= 0);
+			if(exact[n]) {
+				p1[n] = p2[n] = p3[n] = p4[n] = src.ptr<_Tp>(i+s.ey) + j + s.ex;
+			} else {
+				p1[n] = src.ptr<_Tp>(i+s.fy) + j + s.fx;
+				p2[n] = src.ptr<_Tp>(i+s.fy) + j + s.cx;
+				p3[n] = src.ptr<_Tp>(i+s.cy) + j + s.fx;
+				p4[n] = src.ptr<_Tp>(i+s.cy) + j + s.cx;
+			}
+		}
+	}
+};
+
+// The sampling pattern of a compile-time (R,P) configuration in a static
+// table. It is filled once from SamplingPlan(R,P), so the offsets and
+// weights are the same floats as in the cached plans and the codes are
+// bit-exact, but the kernels templated on R and P read it without a lookup.
+template <int R, int P>
+struct FixedSampling {
+	lbp::SamplingPlan::Sample samples[P];
+
+	FixedSampling() {
+		const lbp::SamplingPlan plan(R, P);
+		for(int n=0; n<P; n++)
+			samples[n] = plan.samples[n];
+	}
+
+	//! returns the table, filled on first use
+	static const lbp::SamplingPlan::Sample* get() {
+		static const FixedSampling table;
+		return table.samples;
+	}
+};
+
+enum { ELBP_BLOCK = 64 };
+
+// Type the center is compared in: the neighbors are interpolated in float,
+// so t-c is a float difference for all types but double.
+template <typename _Tp> struct CenterType { typedef float type; };
+template <> struct CenterType<double> { typedef double type; };
+
+// computes the codes of the len <= ELBP_BLOCK output pixels j0, ..., j0+len-1
+// of a row. The codes are built up in a small local buffer and written once,
+// so the inner loops run over contiguous pixels.
+//
+// P and LEN fix the number of neighbors and the block length at compile
+// time, if they are not 0. Then the compiler knows the trip counts and drops
+// the remainder loops, the result is the same.
+//
+// We are dealing with floating point precision, so there's some little
+// tolerance: a neighbor is set if t > c and |t-c| > eps. As t > c implies
+// t-c >= 0 (and NaNs fail both tests), this is the same as t-c > eps, which
+// the compiler can vectorize.
+template <typename _Tp, typename _Dp, int P, int LEN>
+static inline void elbp_block_(const SampleRows<_Tp>& rows, const lbp::SamplingPlan::Sample* samples, int neighbors, const int* table, const _Tp* center, _Dp* d, int j0, int len) {
+	typedef typename CenterType<_Tp>::type center_t;
+	if(P)
+		neighbors = P;
+	if(LEN)
+		len = LEN;
+	const float eps = std::numeric_limits<float>::epsilon();
+	unsigned int code[ELBP_BLOCK];
+	center_t c[ELBP_BLOCK]; // converted once instead of once per neighbor
+	for(int j=0; j<len; j++) {
+		code[j] = 0;
+		c[j] = static_cast<center_t>(center[j0+j]);
+	}
 	for(int n=0; n<neighbors; n++) {
-		// sample points
-		float x = static_cast<float>(radius) * cos(2.0*M_PI*n/static_cast<float>(neighbors));
-		float y = static_cast<float>(radius) * -sin(2.0*M_PI*n/static_cast<float>(neighbors));
-		// relative indices
-		int fx = static_cast<int>(floor(x));
-		int fy = static_cast<int>(floor(y));
-		int cx = static_cast<int>(ceil(x));
-		int cy = static_cast<int>(ceil(y));
-		// fractional part
-		float ty = y - fy;
-		float tx = x - fx;
-		// set interpolation weights
-		float w1 = (1 - tx) * (1 - ty);
-		float w2 =      tx  * (1 - ty);
-		float w3 = (1 - tx) *      ty;
-		float w4 =      tx  *      ty;
-		// iterate through your data
-		for(int i=radius; i < src.rows-radius;i++) {
-			for(int j=radius;j < src.cols-radius;j++) {
-				float t = w1*src.at<_Tp>(i+fy,j+fx) + w2*src.at<_Tp>(i+fy,j+cx) + w3*src.at<_Tp>(i+cy,j+fx) + w4*src.at<_Tp>(i+cy,j+cx);
-				_delta.at<float>(i,j) = t - _mean.at<float>(i,j);
-				_mean.at<float>(i,j) = (_mean.at<float>(i,j) + (_delta.at<float>(i,j) / (1.0*(n+1)))); // i am a bit paranoid
-				_m2.at<float>(i,j) = _m2.at<float>(i,j) + _delta.at<float>(i,j) * (t - _mean.at<float>(i,j));
+		const lbp::SamplingPlan::Sample& s = samples[n];
+		const _Tp* p1 = rows.p1[n] + j0;
+		if(rows.exact[n]) {
+			for(int j=0; j<len; j++) {
+				float t = static_cast<float>(p1[j]);
+				code[j] |= static_cast<unsigned int>(t-c[j] > eps) << n;
+			}
+		} else {
+			const _Tp* p2 = rows.p2[n] + j0;
+			const _Tp* p3 = rows.p3[n] + j0;
+			const _Tp* p4 = rows.p4[n] + j0;
+			const float w1 = s.w1, w2 = s.w2, w3 = s.w3, w4 = s.w4;
+			for(int j=0; j<len; j++) {
+				float t = w1*p1[j] + w2*p2[j] + w3*p3[j] + w4*p4[j];
+				code[j] |= static_cast<unsigned int>(t-c[j] > eps) << n;
+			}
+		}
+	}
+	if(table) {
+		for(int j=0; j<len; j++)
+			d[j0+j] = static_cast<_Dp>(table[code[j]]);
+	} else {
+		for(int j=0; j<len; j++)
+			d[j0+j] = static_cast<_Dp>(code[j]);
+	}
+}
+
+// computes the output rows [begin, end) of the extended lbp operator, with
+// P neighbors or the given number if P is 0, into codes of type _Dp
+template <typename _Tp, int P, typename _Dp>
+static inline void elbp_rows_impl_(const Mat& src, Mat& dst, const lbp::SamplingPlan::Sample* samples, int radius, int neighbors, const int* table, int begin, int end) {
+	const int full = dst.cols - dst.cols % ELBP_BLOCK;
+	SampleRows<_Tp> rows;
+	for(int i=begin; i<end; i++) {
+		rows.set(src, samples, P ? P : neighbors, i+radius, radius);
+		const _Tp* center = src.ptr<_Tp>(i+radius) + radius;
+		_Dp* d = dst.ptr<_Dp>(i);
+		for(int j0=0; j0<full; j0+=ELBP_BLOCK)
+			elbp_block_<_Tp, _Dp, P, ELBP_BLOCK>(rows, samples, neighbors, table, center, d, j0, ELBP_BLOCK);
+		if(full < dst.cols)
+			elbp_block_<_Tp, _Dp, P, 0>(rows, samples, neighbors, table, center, d, full, dst.cols-full);
+	}
+}
+
+// the kernel on the cached plan of args
+template <typename _Tp, int P, typename _Dp>
+static void elbp_rows_(const Mat& src, Mat& dst, const KernelArgs& args, int begin, int end) {
+	const lbp::SamplingPlan& plan = *args.plan;
+	elbp_rows_impl_<_Tp, P, _Dp>(src, dst, &plan.samples[0], plan.radius, plan.neighbors, args.table, begin, end);
+}
+
+// the kernel with R and P fixed at compile time, on the static table of (R,P)
+template <typename _Tp, int R, int P, typename _Dp>
+static void elbp_rows_rp_(const Mat& src, Mat& dst, const KernelArgs& args, int begin, int end) {
+	elbp_rows_impl_<_Tp, P, _Dp>(src, dst, FixedSampling<R,P>::get(), R, P, args.table, begin, end);
+}
+
+//------------------------------------------------------------------------------
+// fixed-point lbp::ELBP_ for 8 and 16 bit input
+//------------------------------------------------------------------------------
+
+// Number of fractional bits of the weights and the offset which maps the
+// input to unsigned values, for the types with a fixed-point kernel. With
+// Q8 the interpolation of 8 bit input fits into 16 bit lanes, with Q15 the
+// interpolation of 16 bit input fits into signed 32 bit lanes.
+template <typename _Tp> struct FixedPoint { enum { supported = 0, Q = 0, bias = 0 }; };
+template <> struct FixedPoint<unsigned char> { enum { supported = 1, Q = 8, bias = 0 }; };
+template <> struct FixedPoint<char> { enum { supported = 1, Q = 8, bias = -CHAR_MIN }; };
+template <> struct FixedPoint<unsigned short> { enum { supported = 1, Q = 15, bias = 0 }; };
+template <> struct FixedPoint<short> { enum { supported = 1, Q = 15, bias = -SHRT_MIN }; };
+
+// The vectorized row kernels compute the codes of as many columns as they
+// can and return the number of columns processed, elbp_fixed_rows_ computes
+// the rest with the same integer arithmetic.
+template <typename _Tp>
+static inline int elbp_fixed_row_simd_(const SampleRows<_Tp>&, const unsigned int (*)[4], int, const _Tp*, int*, int) {
+	return 0;
+}
+
+#ifdef LBP_SSE2
+// 8 codes per iteration: the 8 bit taps are widened to 16 bit and weighted
+// in Q8, the sums (at most 255*256) are compared unsigned through a bias.
+static int elbp_fixed_row_8_sse2(const unsigned char* const* p1, const unsigned char* const* p2, const unsigned char* const* p3, const unsigned char* const* p4,
+		const bool* exact, const unsigned int (*weights)[4], int neighbors, const unsigned char* center, int* d, int width, unsigned char bias) {
+	const __m128i z = _mm_setzero_si128();
+	const __m128i b8 = _mm_set1_epi8(static_cast<char>(bias));
+	const __m128i b16 = _mm_set1_epi16(static_cast<short>(0x8000));
+	int j = 0;
+	for(; j <= width - 8; j += 8) {
+		__m128i c = _mm_unpacklo_epi8(_mm_xor_si128(_mm_loadl_epi64((const __m128i*)(center + j)), b8), z);
+		c = _mm_xor_si128(_mm_slli_epi16(c, 8), b16);
+		__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		for(int n=0; n<neighbors; n++) {
+			__m128i t = _mm_unpacklo_epi8(_mm_xor_si128(_mm_loadl_epi64((const __m128i*)(p1[n] + j)), b8), z);
+			if(exact[n]) {
+				t = _mm_slli_epi16(t, 8);
+			} else {
+				t = _mm_mullo_epi16(t, _mm_set1_epi16(static_cast<short>(weights[n][0])));
+				__m128i t2 = _mm_unpacklo_epi8(_mm_xor_si128(_mm_loadl_epi64((const __m128i*)(p2[n] + j)), b8), z);
+				__m128i t3 = _mm_unpacklo_epi8(_mm_xor_si128(_mm_loadl_epi64((const __m128i*)(p3[n] + j)), b8), z);
+				__m128i t4 = _mm_unpacklo_epi8(_mm_xor_si128(_mm_loadl_epi64((const __m128i*)(p4[n] + j)), b8), z);
+				t = _mm_add_epi16(t, _mm_mullo_epi16(t2, _mm_set1_epi16(static_cast<short>(weights[n][1]))));
+				t = _mm_add_epi16(t, _mm_mullo_epi16(t3, _mm_set1_epi16(static_cast<short>(weights[n][2]))));
+				t = _mm_add_epi16(t, _mm_mullo_epi16(t4, _mm_set1_epi16(static_cast<short>(weights[n][3]))));
+			}
+			__m128i mask = _mm_cmpgt_epi16(_mm_xor_si128(t, b16), c);
+			__m128i bit = _mm_set1_epi32(static_cast<int>(1u << n));
+			lo = _mm_or_si128(lo, _mm_and_si128(_mm_unpacklo_epi16(mask, mask), bit));
+			hi = _mm_or_si128(hi, _mm_and_si128(_mm_unpackhi_epi16(mask, mask), bit));
+		}
+		_mm_storeu_si128((__m128i*)(d + j), lo);
+		_mm_storeu_si128((__m128i*)(d + j + 4), hi);
+	}
+	return j;
+}
+
+// adds the Q15 weighted taps to the 32 bit sums lo and hi
+static inline void elbp_fixed_tap16_sse2(const unsigned short* p, unsigned int w, __m128i bias, __m128i& lo, __m128i& hi) {
+	__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), bias);
+	__m128i wv = _mm_set1_epi16(static_cast<short>(w));
+	__m128i l = _mm_mullo_epi16(v, wv);
+	__m128i h = _mm_mulhi_epu16(v, wv);
+	lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(l, h));
+	hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(l, h));
+}
+
+// 8 codes per iteration: the 16 bit taps are weighted in Q15, the products
+// and sums (at most 65535*32768) fit into signed 32 bit lanes.
+static int elbp_fixed_row_16_sse2(const unsigned short* const* p1, const unsigned short* const* p2, const unsigned short* const* p3, const unsigned short* const* p4,
+		const bool* exact, const unsigned int (*weights)[4], int neighbors, const unsigned short* center, int* d, int width, unsigned short bias) {
+	const __m128i z = _mm_setzero_si128();
+	const __m128i b = _mm_set1_epi16(static_cast<short>(bias));
+	int j = 0;
+	for(; j <= width - 8; j += 8) {
+		__m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(center + j)), b);
+		__m128i clo = _mm_slli_epi32(_mm_unpacklo_epi16(c, z), 15);
+		__m128i chi = _mm_slli_epi32(_mm_unpackhi_epi16(c, z), 15);
+		__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		for(int n=0; n<neighbors; n++) {
+			__m128i tlo, thi;
+			if(exact[n]) {
+				__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p1[n] + j)), b);
+				tlo = _mm_slli_epi32(_mm_unpacklo_epi16(v, z), 15);
+				thi = _mm_slli_epi32(_mm_unpackhi_epi16(v, z), 15);
+			} else {
+				tlo = thi = _mm_setzero_si128();
+				elbp_fixed_tap16_sse2(p1[n] + j, weights[n][0], b, tlo, thi);
+				elbp_fixed_tap16_sse2(p2[n] + j, weights[n][1], b, tlo, thi);
+				elbp_fixed_tap16_sse2(p3[n] + j, weights[n][2], b, tlo, thi);
+				elbp_fixed_tap16_sse2(p4[n] + j, weights[n][3], b, tlo, thi);
 			}
+			__m128i bit = _mm_set1_epi32(static_cast<int>(1u << n));
+			lo = _mm_or_si128(lo, _mm_and_si128(_mm_cmpgt_epi32(tlo, clo), bit));
+			hi = _mm_or_si128(hi, _mm_and_si128(_mm_cmpgt_epi32(thi, chi), bit));
+		}
+		_mm_storeu_si128((__m128i*)(d + j), lo);
+		_mm_storeu_si128((__m128i*)(d + j + 4), hi);
+	}
+	return j;
+}
+
+template <>
+inline int elbp_fixed_row_simd_<unsigned char>(const SampleRows<unsigned char>& rows, const unsigned int (*weights)[4], int neighbors, const unsigned char* center, int* d, int width) {
+	if(!haveSSE2())
+		return 0;
+	return elbp_fixed_row_8_sse2(rows.p1, rows.p2, rows.p3, rows.p4, rows.exact, weights, neighbors, center, d, width, 0);
+}
+
+template <>
+inline int elbp_fixed_row_simd_<char>(const SampleRows<char>& rows, const unsigned int (*weights)[4], int neighbors, const char* center, int* d, int width) {
+	if(!haveSSE2())
+		return 0;
+	return elbp_fixed_row_8_sse2(reinterpret_cast<const unsigned char* const*>(rows.p1), reinterpret_cast<const unsigned char* const*>(rows.p2),
+		reinterpret_cast<const unsigned char* const*>(rows.p3), reinterpret_cast<const unsigned char* const*>(rows.p4),
+		rows.exact, weights, neighbors, reinterpret_cast<const unsigned char*>(center), d, width, FixedPoint<char>::bias);
+}
+
+template <>
+inline int elbp_fixed_row_simd_<unsigned short>(const SampleRows<unsigned short>& rows, const unsigned int (*weights)[4], int neighbors, const unsigned short* center, int* d, int width) {
+	if(!haveSSE2())
+		return 0;
+	return elbp_fixed_row_16_sse2(rows.p1, rows.p2, rows.p3, rows.p4, rows.exact, weights, neighbors, center, d, width, 0);
+}
+
+template <>
+inline int elbp_fixed_row_simd_<short>(const SampleRows<short>& rows, const unsigned int (*weights)[4], int neighbors, const short* center, int* d, int width) {
+	if(!haveSSE2())
+		return 0;
+	return elbp_fixed_row_16_sse2(reinterpret_cast<const unsigned short* const*>(rows.p1), reinterpret_cast<const unsigned short* const*>(rows.p2),
+		reinterpret_cast<const unsigned short* const*>(rows.p3), reinterpret_cast<const unsigned short* const*>(rows.p4),
+		rows.exact, weights, neighbors, reinterpret_cast<const unsigned short*>(center), d, width, FixedPoint<short>::bias);
+}
+#endif
+
+// Computes the output rows [begin, end) of the extended lbp operator in
+// fixed point. A neighbor is set if its interpolated value, in units of
+// 2^-Q, is larger than the center:
+//
+//   sum_k wq_k*(p_k+bias) > (c+bias) << Q, with sum_k wq_k = 2^Q
+//
+// All of it is exact integer arithmetic, so the codes don't depend on the
+// platform, the compiler or the vector width. Samples on the grid compare
+// the pixels directly, just like the float path. For the other samples the
+// errors e_k = wq_k*2^-Q - w_k of the weights sum to 0 and the largest one
+// takes the rounding of the other three, so sum_k |e_k| <= 3*2^-Q and the
+// interpolated values differ by at most 1.5*2^-Q*(max_k p_k - min_k p_k).
+// A bit can only differ from the float path if the neighbor is that close
+// to the center: within 1.5 gray levels for 8 bit input (Q8) and within 3
+// for 16 bit input (Q15). The float path may set bits on flat neighborhoods
+// because of rounding, the fixed-point path never does.
+//
+// The vector kernels write int codes, for narrower codes a row goes through
+// a buffer first.
+template <typename _Tp, typename _Dp>
+static void elbp_fixed_rows_(const Mat& src, Mat& dst, const KernelArgs& args, int begin, int end) {
+	const int Q = FixedPoint<_Tp>::Q;
+	const unsigned int bias = FixedPoint<_Tp>::bias;
+	const lbp::SamplingPlan& plan = *args.plan;
+	const int radius = plan.radius;
+	const int neighbors = plan.neighbors;
+	const int* table = args.table;
+	const unsigned int (*weights)[4] = reinterpret_cast<const unsigned int (*)[4]>(Q == 8 ? &plan.q8[0] : &plan.q15[0]);
+	const bool narrow = DataType<_Dp>::depth != CV_32S;
+	AutoBuffer<int> buffer(narrow ? dst.cols : 1);
+	SampleRows<_Tp> rows;
+	for(int i=begin; i<end; i++) {
+		rows.set(src, plan, i+radius, radius);
+		const _Tp* center = src.ptr<_Tp>(i+radius) + radius;
+		_Dp* out = dst.ptr<_Dp>(i);
+		int* d = narrow ? static_cast<int*>(buffer) : reinterpret_cast<int*>(out);
+		int j = elbp_fixed_row_simd_<_Tp>(rows, weights, neighbors, center, d, dst.cols);
+		if(table) {
+			for(int k=0; k<j; k++)
+				d[k] = table[d[k]];
+		}
+		for(; j<dst.cols; j++) {
+			const unsigned int c = static_cast<unsigned int>(center[j] + bias) << Q;
+			unsigned int code = 0;
+			for(int n=0; n<neighbors; n++) {
+				unsigned int t;
+				if(rows.exact[n]) {
+					t = static_cast<unsigned int>(rows.p1[n][j] + bias) << Q;
+				} else {
+					t = weights[n][0]*static_cast<unsigned int>(rows.p1[n][j] + bias)
+						+ weights[n][1]*static_cast<unsigned int>(rows.p2[n][j] + bias)
+						+ weights[n][2]*static_cast<unsigned int>(rows.p3[n][j] + bias)
+						+ weights[n][3]*static_cast<unsigned int>(rows.p4[n][j] + bias);
+				}
+				code |= static_cast<unsigned int>(t > c) << n;
+			}
+			d[j] = table ? table[code] : static_cast<int>(code);
+		}
+		if(narrow) {
+			for(int k=0; k<dst.cols; k++)
+				out[k] = static_cast<_Dp>(d[k]);
 		}
 	}
-	// calculate result
-	for(int i = radius; i < src.rows-radius; i++) {
-		for(int j = radius; j < src.cols-radius; j++) {
-			dst.at<float>(i-radius, j-radius) = _m2.at<float>(i,j) / (1.0*(neighbors-1));
+}
+
+// The row kernel for (radius, neighbors). With lbp::setUseFixedPoint(true)
+// 8 and 16 bit input takes the fixed-point kernel. Otherwise the common
+// configurations (1,8), (2,8), (2,16) and (3,24) get the kernel templated
+// on R and P, the other radii of 8, 16 and 24 neighbors a kernel with a
+// compile-time trip count and all others the generic one.
+template <typename _Tp, typename _Dp>
+static RowsFunc elbp_rows_func_(int radius, int neighbors) {
+	if(FixedPoint<_Tp>::supported && lbp_fixed_point)
+		return elbp_fixed_rows_<_Tp, _Dp>;
+	if(radius == 1 && neighbors == 8)
+		return elbp_rows_rp_<_Tp, 1, 8, _Dp>;
+	if(radius == 2 && neighbors == 8)
+		return elbp_rows_rp_<_Tp, 2, 8, _Dp>;
+	if(radius == 2 && neighbors == 16)
+		return elbp_rows_rp_<_Tp, 2, 16, _Dp>;
+	if(radius == 3 && neighbors == 24)
+		return elbp_rows_rp_<_Tp, 3, 24, _Dp>;
+	switch(neighbors) {
+		case 8: return elbp_rows_<_Tp, 8, _Dp>;
+		case 16: return elbp_rows_<_Tp, 16, _Dp>;
+		case 24: return elbp_rows_<_Tp, 24, _Dp>;
+	}
+	return elbp_rows_<_Tp, 0, _Dp>;
+}
+
+// the row kernel writing codes of the given depth
+template <typename _Tp>
+static RowsFunc elbp_rows_func(int radius, int neighbors, int depth) {
+	switch(depth) {
+		case CV_8U: return elbp_rows_func_<_Tp, unsigned char>(radius, neighbors);
+		case CV_16U: return elbp_rows_func_<_Tp, unsigned short>(radius, neighbors);
+	}
+	return elbp_rows_func_<_Tp, int>(radius, neighbors);
+}
+
+// Returns the depth of codes up to maxCode: ddepth if given, else the
+// smallest of CV_8U, CV_16U and CV_32S that holds them.
+static int code_depth(int maxCode, int ddepth) {
+	if(ddepth < 0)
+		return (maxCode <= UCHAR_MAX) ? CV_8U : (maxCode <= USHRT_MAX) ? CV_16U : CV_32S;
+	if(ddepth != CV_8U && ddepth != CV_16U && ddepth != CV_32S)
+		CV_Error(CV_StsBadArg, format("Codes are written as CV_8U, CV_16U or CV_32S, but depth %d was given.", ddepth));
+	if((ddepth == CV_8U && maxCode > UCHAR_MAX) || (ddepth == CV_16U && maxCode > USHRT_MAX))
+		CV_Error(CV_StsBadArg, format("Codes up to %d don't fit into depth %d.", maxCode, ddepth));
+	return ddepth;
+}
+
+// the largest plain code of an operator with neighbors <= 31 neighbors
+static inline int max_code(int neighbors) {
+	return static_cast<int>((1u << neighbors) - 1);
+}
+
+template <typename _Tp>
+void lbp::ELBP_(const Mat& src, Mat& dst, int radius, int neighbors, int ddepth) {
+	neighbors = max(min(neighbors,31),1); // set bounds...
+	int depth = code_depth(max_code(neighbors), ddepth);
+	dst.create(src.rows-2*radius, src.cols-2*radius, CV_MAKETYPE(depth, 1));
+	parallel_rows(elbp_rows_func<_Tp>(radius, neighbors, depth), src, dst, KernelArgs(&SamplingPlan::get(radius, neighbors)));
+}
+
+template <typename _Tp>
+void lbp::ELBP_(const Mat& src, Mat& dst, const Mapping& mapping, int radius, int ddepth) {
+	int depth = code_depth(mapping.numPatterns()-1, ddepth);
+	dst.create(src.rows-2*radius, src.cols-2*radius, CV_MAKETYPE(depth, 1));
+	KernelArgs args(&SamplingPlan::get(radius, mapping.neighbors()), mapping.table().ptr<int>(0));
+	parallel_rows(elbp_rows_func<_Tp>(radius, mapping.neighbors(), depth), src, dst, args);
+}
+
+template <typename _Tp, int radius, int neighbors>
+void lbp::ELBP_(const Mat& src, Mat& dst, int ddepth) {
+	int depth = code_depth(max_code(neighbors), ddepth);
+	dst.create(src.rows-2*radius, src.cols-2*radius, CV_MAKETYPE(depth, 1));
+	// only the fixed-point kernel needs the plan, for its Q weights
+	if(FixedPoint<_Tp>::supported && lbp_fixed_point) {
+		parallel_rows(elbp_rows_func<_Tp>(radius, neighbors, depth), src, dst, KernelArgs(&SamplingPlan::get(radius, neighbors)));
+		return;
+	}
+	RowsFunc func = elbp_rows_rp_<_Tp, radius, neighbors, int>;
+	switch(depth) {
+		case CV_8U: func = elbp_rows_rp_<_Tp, radius, neighbors, unsigned char>; break;
+		case CV_16U: func = elbp_rows_rp_<_Tp, radius, neighbors, unsigned short>; break;
+	}
+	parallel_rows(func, src, dst, KernelArgs());
+}
+
+//------------------------------------------------------------------------------
+// multi-scale lbp::ELBP_
+//------------------------------------------------------------------------------
+
+// one scale of the multi-scale operator
+struct ScaleKernel {
+	RowsFunc func;
+	KernelArgs args;
+	Mat dst;
+};
+
+// Computes the rows of all scales centered on the source rows [begin, end).
+// The source is walked once in strips as high as the largest neighborhood
+// and every scale computes the rows centered on a strip with one call of its
+// row kernel. So the kernels are set up once per strip, not once per row,
+// and all scales read the rows around a strip while they are in cache.
+static void elbp_multi_rows(const Mat& src, vector<ScaleKernel>& scales, int begin, int end) {
+	int span = 1;
+	for(size_t k=0; k<scales.size(); k++)
+		span = max(span, 2*scales[k].args.plan->radius+1);
+	for(int y0=begin; y0<end; y0+=span) {
+		int y1 = min(y0+span, end);
+		for(size_t k=0; k<scales.size(); k++) {
+			int radius = scales[k].args.plan->radius;
+			int first = max(y0, radius), last = min(y1, src.rows-radius);
+			if(first < last)
+				scales[k].func(src, scales[k].dst, scales[k].args, first-radius, last-radius);
+		}
+	}
+}
+
+class MultiScaleInvoker : public ParallelLoopBody {
+public:
+	MultiScaleInvoker(const Mat& src, const vector<ScaleKernel>& scales) :
+		src(src), scales(scales) {}
+
+	void operator()(const Range& range) const {
+		vector<ScaleKernel> bands(scales);
+		elbp_multi_rows(src, bands, range.start, range.end);
+	}
+
+private:
+	Mat src;
+	vector<ScaleKernel> scales;
+};
+
+template <typename _Tp>
+static void elbp_multi_(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<int>& neighbors, const vector<lbp::Mapping>* mappings) {
+	if(radii.size() != neighbors.size())
+		CV_Error(CV_StsBadArg, format("Got %d radii, but %d scales.", (int)radii.size(), (int)neighbors.size()));
+	vector<ScaleKernel> scales(radii.size());
+	dst.resize(radii.size());
+	int minRadius = src.rows;
+	for(size_t k=0; k<radii.size(); k++) {
+		int radius = radii[k];
+		if(radius < 1 || 2*radius >= src.rows || 2*radius >= src.cols)
+			CV_Error(CV_StsBadArg, format("Radius %d doesn't fit into a %d x %d image.", radius, src.cols, src.rows));
+		int count = max(min(neighbors[k],31),1);
+		int depth = code_depth(mappings ? (*mappings)[k].numPatterns()-1 : max_code(count), -1);
+		scales[k].func = elbp_rows_func<_Tp>(radius, count, depth);
+		scales[k].args = KernelArgs(&lbp::SamplingPlan::get(radius, count), mappings ? (*mappings)[k].table().ptr<int>(0) : NULL);
+		dst[k].create(src.rows-2*radius, src.cols-2*radius, CV_MAKETYPE(depth, 1));
+		scales[k].dst = dst[k];
+		minRadius = min(minRadius, radius);
+	}
+	if(scales.empty())
+		return;
+	Range rows(minRadius, src.rows-minRadius);
+	int bands = band_count(rows.size());
+	if(bands <= 1)
+		elbp_multi_rows(src, scales, rows.start, rows.end);
+	else
+		parallel_for_(rows, MultiScaleInvoker(src, scales), bands);
+}
+
+template <typename _Tp>
+void lbp::ELBP_(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<int>& neighbors) {
+	elbp_multi_<_Tp>(src, dst, radii, neighbors, NULL);
+}
+
+template <typename _Tp>
+void lbp::ELBP_(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<Mapping>& mappings) {
+	vector<int> neighbors;
+	for(size_t k=0; k<mappings.size(); k++)
+		neighbors.push_back(mappings[k].neighbors());
+	elbp_multi_<_Tp>(src, dst, radii, neighbors, &mappings);
+}
+
+//------------------------------------------------------------------------------
+// lbp::VARLBP_
+//------------------------------------------------------------------------------
+
+// computes the output rows [begin, end) of the variance-based lbp operator.
+// The on-line (Welford) mean and variance of a strip of columns are kept in
+// small local buffers, so there are no full-frame temporaries and a caller
+// reusing dst doesn't allocate anything. P fixes the number of neighbors at
+// compile time, if it is not 0.
+template <typename _Tp, int P>
+static inline void varlbp_rows_impl_(const Mat& src, Mat& dst, const lbp::SamplingPlan::Sample* samples, int radius, int neighbors, int begin, int end) {
+	enum { BLOCK = 64 };
+	if(P)
+		neighbors = P;
+	SampleRows<_Tp> rows;
+	float mean[BLOCK];
+	float m2[BLOCK];
+	for(int i=begin; i<end; i++) {
+		rows.set(src, samples, neighbors, i+radius, radius);
+		float* d = dst.ptr<float>(i);
+		for(int j0=0; j0<dst.cols; j0+=BLOCK) {
+			const int len = min(static_cast<int>(BLOCK), dst.cols-j0);
+			for(int j=0; j<len; j++)
+				mean[j] = m2[j] = 0.0f;
+			for(int n=0; n<neighbors; n++) {
+				const lbp::SamplingPlan::Sample& s = samples[n];
+				const _Tp* p1 = rows.p1[n] + j0;
+				const _Tp* p2 = rows.p2[n] + j0;
+				const _Tp* p3 = rows.p3[n] + j0;
+				const _Tp* p4 = rows.p4[n] + j0;
+				for(int j=0; j<len; j++) {
+					float t = rows.exact[n] ? static_cast<float>(p1[j]) : s.w1*p1[j] + s.w2*p2[j] + s.w3*p3[j] + s.w4*p4[j];
+					float delta = t - mean[j];
+					mean[j] = (mean[j] + (delta / (1.0*(n+1)))); // i am a bit paranoid
+					m2[j] = m2[j] + delta * (t - mean[j]);
+				}
+			}
+			// calculate result
+			for(int j=0; j<len; j++)
+				d[j0+j] = m2[j] / (1.0*(neighbors-1));
 		}
 	}
 }
 
+template <typename _Tp, int P>
+static void varlbp_rows_(const Mat& src, Mat& dst, const KernelArgs& args, int begin, int end) {
+	const lbp::SamplingPlan& plan = *args.plan;
+	varlbp_rows_impl_<_Tp, P>(src, dst, &plan.samples[0], plan.radius, plan.neighbors, begin, end);
+}
+
+template <typename _Tp, int R, int P>
+static void varlbp_rows_rp_(const Mat& src, Mat& dst, const KernelArgs&, int begin, int end) {
+	varlbp_rows_impl_<_Tp, P>(src, dst, FixedSampling<R,P>::get(), R, P, begin, end);
+}
+
+// the row kernel for (radius, neighbors), chosen like elbp_rows_func_
+template <typename _Tp>
+static RowsFunc varlbp_rows_func(int radius, int neighbors) {
+	if(radius == 1 && neighbors == 8)
+		return varlbp_rows_rp_<_Tp, 1, 8>;
+	if(radius == 2 && neighbors == 8)
+		return varlbp_rows_rp_<_Tp, 2, 8>;
+	if(radius == 2 && neighbors == 16)
+		return varlbp_rows_rp_<_Tp, 2, 16>;
+	if(radius == 3 && neighbors == 24)
+		return varlbp_rows_rp_<_Tp, 3, 24>;
+	switch(neighbors) {
+		case 8: return varlbp_rows_<_Tp, 8>;
+		case 16: return varlbp_rows_<_Tp, 16>;
+		case 24: return varlbp_rows_<_Tp, 24>;
+	}
+	return varlbp_rows_<_Tp, 0>;
+}
+
+template <typename _Tp>
+void lbp::VARLBP_(const Mat& src, Mat& dst, int radius, int neighbors) {
+	neighbors = max(min(neighbors,31),1); // set bounds
+	dst.create(src.rows-2*radius, src.cols-2*radius, CV_32FC1); //! result
+	parallel_rows(varlbp_rows_func<_Tp>(radius, neighbors), src, dst, KernelArgs(&SamplingPlan::get(radius, neighbors)));
+}
+
+template <typename _Tp, int radius, int neighbors>
+void lbp::VARLBP_(const Mat& src, Mat& dst) {
+	dst.create(src.rows-2*radius, src.cols-2*radius, CV_32FC1);
+	parallel_rows(varlbp_rows_rp_<_Tp, radius, neighbors>, src, dst, KernelArgs());
+}
+
+// the compile-time configurations for all supported types
+#define LBP_INSTANTIATE_FIXED(_Tp) \
+	template void lbp::ELBP_<_Tp, 1, 8>(const Mat&, Mat&, int); \
+	template void lbp::ELBP_<_Tp, 2, 8>(const Mat&, Mat&, int); \
+	template void lbp::ELBP_<_Tp, 2, 16>(const Mat&, Mat&, int); \
+	template void lbp::ELBP_<_Tp, 3, 24>(const Mat&, Mat&, int); \
+	template void lbp::VARLBP_<_Tp, 1, 8>(const Mat&, Mat&); \
+	template void lbp::VARLBP_<_Tp, 2, 8>(const Mat&, Mat&); \
+	template void lbp::VARLBP_<_Tp, 2, 16>(const Mat&, Mat&); \
+	template void lbp::VARLBP_<_Tp, 3, 24>(const Mat&, Mat&);
+LBP_INSTANTIATE_FIXED(char)
+LBP_INSTANTIATE_FIXED(unsigned char)
+LBP_INSTANTIATE_FIXED(short)
+LBP_INSTANTIATE_FIXED(unsigned short)
+LBP_INSTANTIATE_FIXED(int)
+LBP_INSTANTIATE_FIXED(float)
+LBP_INSTANTIATE_FIXED(double)
+#undef LBP_INSTANTIATE_FIXED
+
+//------------------------------------------------------------------------------
+// border handling
+//------------------------------------------------------------------------------
+
+// The operators as functors, called with LBP_BORDER_NONE on the parts of an
+// image with a border.
+struct OlbpOp {
+	void operator()(const Mat& src, Mat& dst) const { lbp::OLBP(src, dst); }
+};
+
+struct ElbpOp {
+	int radius, neighbors, ddepth;
+	ElbpOp(int radius, int neighbors, int ddepth) : radius(radius), neighbors(neighbors), ddepth(ddepth) {}
+	void operator()(const Mat& src, Mat& dst) const { lbp::ELBP(src, dst, radius, neighbors, lbp::LBP_BORDER_NONE, ddepth); }
+};
+
+struct MappedElbpOp {
+	const lbp::Mapping* mapping;
+	int radius, ddepth;
+	MappedElbpOp(const lbp::Mapping& mapping, int radius, int ddepth) : mapping(&mapping), radius(radius), ddepth(ddepth) {}
+	void operator()(const Mat& src, Mat& dst) const { lbp::ELBP(src, dst, *mapping, radius, lbp::LBP_BORDER_NONE, ddepth); }
+};
+
+struct VarlbpOp {
+	int radius, neighbors;
+	VarlbpOp(int radius, int neighbors) : radius(radius), neighbors(neighbors) {}
+	void operator()(const Mat& src, Mat& dst) const { lbp::VARLBP(src, dst, radius, neighbors); }
+};
+
+// Computes op with an output of the size of src. The interior is written
+// straight into a ROI of dst, the operators only create() a matrix of the
+// size they already have, so they fill the ROI in place. The four strips of
+// width radius along the edges are computed on copies of the outer 2*radius
+// rows and columns of src, padded by cv::copyMakeBorder. BORDER_ISOLATED
+// keeps copyMakeBorder from reading pixels beyond these ROIs, the padding
+// then equals the one of the whole image. BORDER_WRAP takes its pixels from
+// the opposite edge, so it pads the whole image instead.
+template <typename Op>
+static void with_border(const Mat& src, Mat& dst, int type, int radius, int borderType, const Op& op) {
+	if(radius < 1)
+		CV_Error(CV_StsBadArg, format("The radius must be positive, but was %d.", radius));
+	const int r = radius;
+	const int flags = borderType | BORDER_ISOLATED;
+	dst.create(src.rows, src.cols, type);
+	Mat padded;
+	if(src.rows < 2*r+1 || src.cols < 2*r+1 || (borderType & ~BORDER_ISOLATED) == BORDER_WRAP) {
+		copyMakeBorder(src, padded, r, r, r, r, flags);
+		op(padded, dst);
+		return;
+	}
+	Mat interior = dst(Rect(r, r, src.cols-2*r, src.rows-2*r));
+	op(src, interior);
+	// top and bottom strips with the corners
+	Mat top = dst.rowRange(0, r);
+	copyMakeBorder(src.rowRange(0, 2*r), padded, r, 0, r, r, flags);
+	op(padded, top);
+	Mat bottom = dst.rowRange(src.rows-r, src.rows);
+	copyMakeBorder(src.rowRange(src.rows-2*r, src.rows), padded, 0, r, r, r, flags);
+	op(padded, bottom);
+	// left and right strips between them
+	Mat left = dst(Rect(0, r, r, src.rows-2*r));
+	copyMakeBorder(src.colRange(0, 2*r), padded, 0, 0, r, 0, flags);
+	op(padded, left);
+	Mat right = dst(Rect(src.cols-r, r, r, src.rows-2*r));
+	copyMakeBorder(src.colRange(src.cols-2*r, src.cols), padded, 0, 0, 0, r, flags);
+	op(padded, right);
+}
+
 // now the wrapper functions
-void lbp::OLBP(const Mat& src, Mat& dst) {
+void lbp::OLBP(const Mat& src, Mat& dst, int borderType) {
+	if(borderType != LBP_BORDER_NONE) {
+		with_border(src, dst, CV_8UC1, 1, borderType, OlbpOp());
+		return;
+	}
 	switch(src.type()) {
 		case CV_8SC1: OLBP_<char>(src, dst); break;
 		case CV_8UC1: OLBP_<unsigned char>(src, dst); break;
@@ -114,19 +1210,102 @@ void lbp::OLBP(const Mat& src, Mat& dst) {
 	}
 }
 
-void lbp::ELBP(const Mat& src, Mat& dst, int radius, int neighbors) {
+void lbp::ELBP(const Mat& src, Mat& dst, int radius, int neighbors, int borderType, int ddepth) {
+	if(borderType != LBP_BORDER_NONE) {
+		int depth = code_depth(max_code(max(min(neighbors,31),1)), ddepth);
+		with_border(src, dst, CV_MAKETYPE(depth, 1), radius, borderType, ElbpOp(radius, neighbors, depth));
+		return;
+	}
+	switch(src.type()) {
+		case CV_8SC1: ELBP_<char>(src, dst, radius, neighbors, ddepth); break;
+		case CV_8UC1: ELBP_<unsigned char>(src, dst, radius, neighbors, ddepth); break;
+		case CV_16SC1: ELBP_<short>(src, dst, radius, neighbors, ddepth); break;
+		case CV_16UC1: ELBP_<unsigned short>(src, dst, radius, neighbors, ddepth); break;
+		case CV_32SC1: ELBP_<int>(src, dst, radius, neighbors, ddepth); break;
+		case CV_32FC1: ELBP_<float>(src, dst, radius, neighbors, ddepth); break;
+		case CV_64FC1: ELBP_<double>(src, dst, radius, neighbors, ddepth); break;
+	}
+}
+
+void lbp::ELBP(const Mat& src, Mat& dst, const Mapping& mapping, int radius, int borderType, int ddepth) {
+	if(borderType != LBP_BORDER_NONE) {
+		int depth = code_depth(mapping.numPatterns()-1, ddepth);
+		with_border(src, dst, CV_MAKETYPE(depth, 1), radius, borderType, MappedElbpOp(mapping, radius, depth));
+		return;
+	}
 	switch(src.type()) {
-		case CV_8SC1: ELBP_<char>(src, dst, radius, neighbors); break;
-		case CV_8UC1: ELBP_<unsigned char>(src, dst, radius, neighbors); break;
-		case CV_16SC1: ELBP_<short>(src, dst, radius, neighbors); break;
-		case CV_16UC1: ELBP_<unsigned short>(src, dst, radius, neighbors); break;
-		case CV_32SC1: ELBP_<int>(src, dst, radius, neighbors); break;
-		case CV_32FC1: ELBP_<float>(src, dst, radius, neighbors); break;
-		case CV_64FC1: ELBP_<double>(src, dst, radius, neighbors); break;
+		case CV_8SC1: ELBP_<char>(src, dst, mapping, radius, ddepth); break;
+		case CV_8UC1: ELBP_<unsigned char>(src, dst, mapping, radius, ddepth); break;
+		case CV_16SC1: ELBP_<short>(src, dst, mapping, radius, ddepth); break;
+		case CV_16UC1: ELBP_<unsigned short>(src, dst, mapping, radius, ddepth); break;
+		case CV_32SC1: ELBP_<int>(src, dst, mapping, radius, ddepth); break;
+		case CV_32FC1: ELBP_<float>(src, dst, mapping, radius, ddepth); break;
+		case CV_64FC1: ELBP_<double>(src, dst, mapping, radius, ddepth); break;
 	}
 }
 
-void lbp::VARLBP(const Mat& src, Mat& dst, int radius, int neighbors) {
+template <typename _Tp>
+static void elbp_level_(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<int>& neighbors, const vector<lbp::Mapping>* mappings) {
+	if(mappings)
+		lbp::ELBP_<_Tp>(src, dst, radii, *mappings);
+	else
+		lbp::ELBP_<_Tp>(src, dst, radii, neighbors);
+}
+
+// Runs the multi-scale operator on every level of a Gaussian pyramid and
+// appends the code maps to dst, level by level. The pyramid stops at the
+// last level the largest radius fits into.
+static void elbp_pyramid(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<int>& neighbors, const vector<lbp::Mapping>* mappings, int levels) {
+	if(levels > 1 && (src.depth() == CV_8S || src.depth() == CV_32S)) {
+		string error_message = format("Pyramids are only supported for CV_8U, CV_16S, CV_16U, CV_32F and CV_64F images, but the depth is %d.", src.depth());
+		CV_Error(CV_StsUnsupportedFormat, error_message);
+	}
+	int maxRadius = 0;
+	for(size_t k=0; k<radii.size(); k++)
+		maxRadius = max(maxRadius, radii[k]);
+	// level 0 is checked by the operator, every pyrDown halves the size
+	Size size = src.size();
+	for(int l=1; l<levels; l++) {
+		size = Size((size.width+1)/2, (size.height+1)/2);
+		if(2*maxRadius >= size.width || 2*maxRadius >= size.height) {
+			levels = l;
+			break;
+		}
+	}
+	vector<Mat> pyramid;
+	if(levels > 1)
+		buildPyramid(src, pyramid, levels-1);
+	else
+		pyramid.push_back(src);
+	dst.clear();
+	for(size_t l=0; l<pyramid.size(); l++) {
+		vector<Mat> maps;
+		switch(pyramid[l].type()) {
+			case CV_8SC1: elbp_level_<char>(pyramid[l], maps, radii, neighbors, mappings); break;
+			case CV_8UC1: elbp_level_<unsigned char>(pyramid[l], maps, radii, neighbors, mappings); break;
+			case CV_16SC1: elbp_level_<short>(pyramid[l], maps, radii, neighbors, mappings); break;
+			case CV_16UC1: elbp_level_<unsigned short>(pyramid[l], maps, radii, neighbors, mappings); break;
+			case CV_32SC1: elbp_level_<int>(pyramid[l], maps, radii, neighbors, mappings); break;
+			case CV_32FC1: elbp_level_<float>(pyramid[l], maps, radii, neighbors, mappings); break;
+			case CV_64FC1: elbp_level_<double>(pyramid[l], maps, radii, neighbors, mappings); break;
+		}
+		dst.insert(dst.end(), maps.begin(), maps.end());
+	}
+}
+
+void lbp::ELBP(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<int>& neighbors, int levels) {
+	elbp_pyramid(src, dst, radii, neighbors, NULL, levels);
+}
+
+void lbp::ELBP(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<Mapping>& mappings, int levels) {
+	elbp_pyramid(src, dst, radii, vector<int>(), &mappings, levels);
+}
+
+void lbp::VARLBP(const Mat& src, Mat& dst, int radius, int neighbors, int borderType) {
+	if(borderType != LBP_BORDER_NONE) {
+		with_border(src, dst, CV_32FC1, radius, borderType, VarlbpOp(radius, neighbors));
+		return;
+	}
 	switch(src.type()) {
 		case CV_8SC1: VARLBP_<char>(src, dst, radius, neighbors); break;
 		case CV_8UC1: VARLBP_<unsigned char>(src, dst, radius, neighbors); break;
@@ -139,9 +1318,10 @@ void lbp::VARLBP(const Mat& src, Mat& dst, int radius, int neighbors) {
 }
 
 // now the Mat return functions
-Mat lbp::OLBP(const Mat& src) { Mat dst; OLBP(src, dst); return dst; }
-Mat lbp::ELBP(const Mat& src, int radius, int neighbors) { Mat dst; ELBP(src, dst, radius, neighbors); return dst; }
-Mat lbp::VARLBP(const Mat& src, int radius, int neighbors) { Mat dst; VARLBP(src, dst, radius, neighbors); return dst; }
+Mat lbp::OLBP(const Mat& src, int borderType) { Mat dst; OLBP(src, dst, borderType); return dst; }
+Mat lbp::ELBP(const Mat& src, int radius, int neighbors, int borderType, int ddepth) { Mat dst; ELBP(src, dst, radius, neighbors, borderType, ddepth); return dst; }
+Mat lbp::ELBP(const Mat& src, const Mapping& mapping, int radius, int borderType, int ddepth) { Mat dst; ELBP(src, dst, mapping, radius, borderType, ddepth); return dst; }
+Mat lbp::VARLBP(const Mat& src, int radius, int neighbors, int borderType) { Mat dst; VARLBP(src, dst, radius, neighbors, borderType); return dst; }
 
 
 
@@ -6,31 +6,173 @@
 
 #include <cv.h>
 #include <limits>
+#include <vector>
 
 using namespace cv;
 using namespace std;
 
 namespace lbp {
 
+// Precomputed sampling pattern of the circular operators. For every neighbor
+// it holds the integer offsets of the four interpolation points relative to
+// the center and the bilinear weights, so the kernels don't need to call
+// cos, sin, floor or ceil. Plans are cached by (radius, neighbors); use
+// SamplingPlan::get to obtain one, the reference stays valid.
+class SamplingPlan {
+public:
+	struct Sample {
+		int fx, fy, cx, cy; // floor and ceil of the sampling point
+		float w1, w2, w3, w4; // weights of (fy,fx), (fy,cx), (cy,fx), (cy,cx)
+		int exact; // 0..3 if a single point has weight 1 and all others 0, else -1
+		int ex, ey; // offsets of that point
+	};
+
+	int radius;
+	int neighbors;
+	vector<Sample> samples;
+	// w1..w4 of every sample rounded to 8 and 15 fractional bits, for the
+	// fixed-point kernels; 4 per sample, each 4 sum to exactly 2^Q
+	vector<unsigned int> q8, q15;
+
+	SamplingPlan(int radius = 1, int neighbors = 8);
+
+	//! returns the cached plan for (radius, neighbors)
+	static const SamplingPlan& get(int radius, int neighbors);
+};
+
+enum {
+	LBP_MAPPING_NONE = 0, // plain codes, 2^P patterns
+	LBP_MAPPING_U2 = 1, // uniform patterns, P*(P-1)+3 patterns
+	LBP_MAPPING_RI = 2, // rotation invariant patterns
+	LBP_MAPPING_RIU2 = 3 // rotation invariant uniform patterns, P+2 patterns
+};
+
+// Lookup table which maps the codes of an operator with P neighbors to
+// uniform (u2), rotation invariant (ri) or rotation invariant uniform (riu2)
+// patterns as described in:
+//
+//   T. Ojala, M. Pietikainen, and T. Maenpaa, "Multiresolution Gray-Scale
+//   and Rotation Invariant Texture Classification with Local Binary
+//   Patterns", IEEE PAMI, 24(7):971--987, 2002.
+//
+// For P=8 this shrinks a histogram from 256 to 59 (u2), 36 (ri) or 10 (riu2)
+// bins. The table has 2^P entries, so P is limited to 24. Tables are cached,
+// so creating a Mapping is cheap.
+class Mapping {
+public:
+	Mapping(int neighbors = 8, int type = LBP_MAPPING_U2);
+	//! number of neighbors of the operator
+	int neighbors() const { return _neighbors; }
+	//! one of the LBP_MAPPING_* constants
+	int type() const { return _type; }
+	//! number of patterns (histogram bins) after the mapping
+	int numPatterns() const { return _numPatterns; }
+	//! the 1 x 2^P CV_32SC1 lookup table
+	const Mat& table() const { return _table; }
+	//! maps a single code
+	int operator()(int code) const { return _table.ptr<int>(0)[code]; }
+
+private:
+	int _neighbors;
+	int _type;
+	int _numPatterns;
+	Mat _table;
+};
+
+// The operators split their output into bands of rows and compute them with
+// cv::parallel_for_, the result is identical to a serial run.
+//! sets the maximum number of bands in flight (0 = OpenCV decides, 1 = serial)
+void setNumThreads(int nthreads);
+int getNumThreads();
+//! sets the minimum number of output rows per band
+void setGrainSize(int rows);
+int getGrainSize();
+
+// With fixed point enabled, lbp::ELBP computes 8 and 16 bit input with
+// integer arithmetic (weights in Q8 and Q15) instead of float. The codes are
+// deterministic and a bit can only differ from the float path if the
+// neighbor is within 1.5 gray levels (8 bit) or 3 units (16 bit) of the
+// center, see elbp_fixed_rows_ in lbp.cpp. Disabled by default.
+void setUseFixedPoint(bool enabled);
+bool useFixedPoint();
+
+// The extended operators write their codes in the smallest depth that holds
+// them: CV_8UC1 for up to 256 patterns (P <= 8), CV_16UC1 for up to 65536
+// (P <= 16) and CV_32SC1 for more. With a mapping the number of patterns of
+// the mapping decides, so riu2 codes of 24 neighbors are CV_8UC1. Pass
+// ddepth = CV_8U, CV_16U or CV_32S to force a depth, it must hold all codes.
+// The multi-scale operators always use the default.
+
 // templated functions
 template <typename _Tp>
 void OLBP_(const cv::Mat& src, cv::Mat& dst);
 
 template <typename _Tp>
-void ELBP_(const cv::Mat& src, cv::Mat& dst, int radius = 1, int neighbors = 8);
+void ELBP_(const cv::Mat& src, cv::Mat& dst, int radius = 1, int neighbors = 8, int ddepth = -1);
+
+template <typename _Tp>
+void ELBP_(const cv::Mat& src, cv::Mat& dst, const Mapping& mapping, int radius = 1, int ddepth = -1);
+
+template <typename _Tp>
+void ELBP_(const cv::Mat& src, vector<cv::Mat>& dst, const vector<int>& radii, const vector<int>& neighbors);
+
+template <typename _Tp>
+void ELBP_(const cv::Mat& src, vector<cv::Mat>& dst, const vector<int>& radii, const vector<Mapping>& mappings);
 
 template <typename _Tp>
 void VARLBP_(const cv::Mat& src, cv::Mat& dst, int radius = 1, int neighbors = 8);
 
+// Operators with the radius and the number of neighbors fixed at compile
+// time. Their kernels are templated on both and read the offsets and
+// weights from a static table per (radius, neighbors), filled once from the
+// same SamplingPlan, so the codes are bit-exact with the runtime operators.
+// They are instantiated for (1,8), (2,8), (2,16) and (3,24); lbp::ELBP and
+// lbp::VARLBP use the same kernels for these configurations on their own.
+template <typename _Tp, int radius, int neighbors>
+void ELBP_(const cv::Mat& src, cv::Mat& dst, int ddepth = -1);
+
+template <typename _Tp, int radius, int neighbors>
+void VARLBP_(const cv::Mat& src, cv::Mat& dst);
+
+// maps a code image (CV_8UC1, CV_16UC1 or CV_32SC1) to CV_32SC1 patterns
+void apply_mapping(const Mat& src, Mat& dst, const Mapping& mapping);
+
+enum {
+	LBP_BORDER_NONE = -1 // no border, the output shrinks by the radius on every side
+};
+
 // wrapper functions
-void OLBP(const Mat& src, Mat& dst);
-void ELBP(const Mat& src, Mat& dst, int radius = 1, int neighbors = 8);
-void VARLBP(const Mat& src, Mat& dst, int radius = 1, int neighbors = 8);
+//
+// By default the output is smaller than src, because the codes are only
+// computed where all neighbors are inside the image. With borderType set to
+// one of cv::BORDER_REPLICATE, cv::BORDER_REFLECT, cv::BORDER_REFLECT_101,
+// cv::BORDER_WRAP or cv::BORDER_CONSTANT (zeros) the output has the size of
+// src and the missing neighbors are extrapolated like cv::copyMakeBorder
+// does. The interior runs through the same kernels as without a border,
+// only the outer radius rows and columns are computed on small padded
+// copies of the image.
+void OLBP(const Mat& src, Mat& dst, int borderType = LBP_BORDER_NONE);
+void ELBP(const Mat& src, Mat& dst, int radius = 1, int neighbors = 8, int borderType = LBP_BORDER_NONE, int ddepth = -1);
+void ELBP(const Mat& src, Mat& dst, const Mapping& mapping, int radius = 1, int borderType = LBP_BORDER_NONE, int ddepth = -1);
+void VARLBP(const Mat& src, Mat& dst, int radius = 1, int neighbors = 8, int borderType = LBP_BORDER_NONE);
+
+// Multi-scale extended lbp operator. Computes lbp::ELBP for every scale
+// (radii[k], neighbors[k]) in a single traversal of src. The type dispatch
+// is shared and src is walked in strips of rows, every scale computes the
+// rows of a strip in one kernel call while the strip is in cache. With
+// levels > 1 it runs on every level of a Gaussian pyramid (cv::buildPyramid,
+// level 0 is src). dst[l*radii.size()+k] is the code image of scale k on
+// level l, of the same size and type as a single lbp::ELBP call returns.
+// Levels too small for the largest radius are left out, so dst may hold
+// fewer than levels levels. Pyramids need input other than CV_8S and CV_32S.
+void ELBP(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<int>& neighbors, int levels = 1);
+void ELBP(const Mat& src, vector<Mat>& dst, const vector<int>& radii, const vector<Mapping>& mappings, int levels = 1);
 
 // Mat return type functions
-Mat OLBP(const Mat& src);
-Mat ELBP(const Mat& src, int radius = 1, int neighbors = 8);
-Mat VARLBP(const Mat& src, int radius = 1, int neighbors = 8);
+Mat OLBP(const Mat& src, int borderType = LBP_BORDER_NONE);
+Mat ELBP(const Mat& src, int radius = 1, int neighbors = 8, int borderType = LBP_BORDER_NONE, int ddepth = -1);
+Mat ELBP(const Mat& src, const Mapping& mapping, int radius = 1, int borderType = LBP_BORDER_NONE, int ddepth = -1);
+Mat VARLBP(const Mat& src, int radius = 1, int neighbors = 8, int borderType = LBP_BORDER_NONE);
 
 }
 #endif
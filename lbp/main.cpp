@@ -1,118 +1,137 @@
 #include <cv.h>
 #include <highgui.h>
+#include <cstdlib>
+#include <cstring>
 #include "lbp.hpp"
 #include "histogram.hpp"
+#include "stream.hpp"
 
 using namespace cv;
 
+static void print_stats(const lbp::LBPStream::Stats& stats) {
+	cout << stats.frames << " frames, " << stats.fps << " fps (ms/frame:"
+		<< " capture=" << stats.capture
+		<< " preprocess=" << stats.preprocess
+		<< " wait=" << stats.wait
+		<< " lbp=" << stats.lbp
+		<< " normalize=" << stats.normalize << ")" << endl;
+}
+
+// usage: lbp [device id | video file] [--headless]
 int main(int argc, const char *argv[]) {
-	int deviceId = 0;
-	if(argc > 1)
-		deviceId = atoi(argv[1]);
+	string source = "0";
+	bool headless = false;
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else
+			source = argv[i];
+	}
 
-	VideoCapture cap(deviceId);
+	// a number is a capture device, everything else a (recorded) file
+	VideoCapture cap;
+	char* end = NULL;
+	int deviceId = static_cast<int>(strtol(source.c_str(), &end, 10));
+	if(*end == '\0')
+		cap.open(deviceId);
+	else
+		cap.open(source);
 
 	if(!cap.isOpened()) {
-    	cerr << "Capture Device ID " << deviceId << "cannot be opened." << endl;
-    	return -1;
-    }
+		cerr << "Capture " << source << " cannot be opened." << endl;
+		return -1;
+	}
 
 	// initial values
-    int radius = 1;
-    int neighbors = 8;
-
-    // windows
-    namedWindow("original",CV_WINDOW_AUTOSIZE);
-    namedWindow("lbp",CV_WINDOW_AUTOSIZE);
+	int radius = 1;
+	int neighbors = 8;
 
-    // matrices used
-    Mat frame; // always references the last frame
-    Mat dst; // image after preprocessing
-    Mat lbp; // lbp image
+	// captures and preprocesses the next frames while the current is shown
+	lbp::LBPStream stream(cap);
+	stream.setRadius(radius);
+	stream.setNeighbors(neighbors);
 
-    // just to switch between possible lbp operators
-    vector<string> lbp_names;
-    lbp_names.push_back("Extended LBP"); // 0
-    lbp_names.push_back("Fixed Sampling LBP"); // 1
-    lbp_names.push_back("Variance-based LBP"); // 2
-    int lbp_operator=0;
+	if(headless) {
+		// process the whole stream as fast as possible
+		while(stream.next()) {
+			if(stream.stats().frames % 100 == 0)
+				print_stats(stream.stats());
+		}
+		print_stats(stream.stats());
+		return 0;
+	}
 
-    bool running=true;
-    while(running) {
-    	cap >> frame;
-    	cvtColor(frame, dst, CV_BGR2GRAY);
-    	GaussianBlur(dst, dst, Size(7,7), 5, 3, BORDER_CONSTANT); // tiny bit of smoothing is always a good idea
-    	// comment the following lines for original size
-    	resize(frame, frame, Size(), 0.5, 0.5);
-    	resize(dst,dst,Size(), 0.5, 0.5);
-    	//
-    	switch(lbp_operator) {
-    	case 0:
-    		lbp::ELBP(dst, lbp, radius, neighbors); // use the extended operator
-    		break;
-    	case 1:
-    		lbp::OLBP(dst, lbp); // use the original operator
-    		break;
-    	case 2:
-    		lbp::VARLBP(dst, lbp, radius, neighbors);
-    		break;
-    	}
-    	// now to show the patterns a normalization is necessary
-    	// a simple min-max norm will do the job...
-    	normalize(lbp, lbp, 0, 255, NORM_MINMAX, CV_8UC1);
+	// windows
+	namedWindow("original",CV_WINDOW_AUTOSIZE);
+	namedWindow("lbp",CV_WINDOW_AUTOSIZE);
 
-    	imshow("original", frame);
-    	imshow("lbp", lbp);
+	// just to switch between possible lbp operators
+	vector<string> lbp_names;
+	lbp_names.push_back("Extended LBP"); // 0
+	lbp_names.push_back("Fixed Sampling LBP"); // 1
+	lbp_names.push_back("Variance-based LBP"); // 2
+	int lbp_operator=0;
 
-    	char key = (char) waitKey(20);
+	bool running=true;
+	while(running && stream.next()) {
+		imshow("original", stream.frame());
+		imshow("lbp", stream.display());
 
-    	// exit on escape
-    	if(key == 27)
-    		running=false;
+		char key = (char) waitKey(20);
 
-    	// to make it a bit interactive, you can increase and decrease the parameters
-    	switch(key) {
-    	case 'q': case 'Q':
-    		running=false;
-    		break;
-    	// lower case r decreases the radius (min 1)
-    	case 'r':
-    		radius-=1;
-    		radius = std::max(radius,1);
-    		cout << "radius=" << radius << endl;
-    		break;
-    	// upper case r increases the radius (there's no real upper bound)
-    	case 'R':
-    		radius+=1;
-    		radius = std::min(radius,32);
-    		cout << "radius=" << radius << endl;
-    		break;
-    	// lower case p decreases the number of sampling points (min 1)
-    	case 'p':
-    		neighbors-=1;
-    		neighbors = std::max(neighbors,1);
-    		cout << "sampling points=" << neighbors << endl;
-    		break;
-    	// upper case p increases the number of sampling points (max 31)
-    	case 'P':
-    		neighbors+=1;
-    		neighbors = std::min(neighbors,31);
-    		cout << "sampling points=" << neighbors << endl;
-    		break;
-    	// switch between operators
-    	case 'o': case 'O':
-    		lbp_operator = (lbp_operator + 1) % 3;
-    		cout << "Switched to operator " << lbp_names[lbp_operator] << endl;
-    		break;
-    	case 's': case 'S':
-    		imwrite("original.jpg", frame);
-    		imwrite("lbp.jpg", lbp);
-    		cout << "Screenshot (operator=" << lbp_names[lbp_operator] << ",radius=" << radius <<",points=" << neighbors << ")" << endl;
-    		break;
-    	default:
-    		break;
-    	}
+		// exit on escape
+		if(key == 27)
+			running=false;
 
-    }
-    	return 0; // success
+		// to make it a bit interactive, you can increase and decrease the parameters
+		switch(key) {
+		case 'q': case 'Q':
+			running=false;
+			break;
+		// lower case r decreases the radius (min 1)
+		case 'r':
+			radius-=1;
+			radius = std::max(radius,1);
+			cout << "radius=" << radius << endl;
+			break;
+		// upper case r increases the radius (there's no real upper bound)
+		case 'R':
+			radius+=1;
+			radius = std::min(radius,32);
+			cout << "radius=" << radius << endl;
+			break;
+		// lower case p decreases the number of sampling points (min 1)
+		case 'p':
+			neighbors-=1;
+			neighbors = std::max(neighbors,1);
+			cout << "sampling points=" << neighbors << endl;
+			break;
+		// upper case p increases the number of sampling points (max 31)
+		case 'P':
+			neighbors+=1;
+			neighbors = std::min(neighbors,31);
+			cout << "sampling points=" << neighbors << endl;
+			break;
+		// switch between operators
+		case 'o': case 'O':
+			lbp_operator = (lbp_operator + 1) % 3;
+			cout << "Switched to operator " << lbp_names[lbp_operator] << endl;
+			break;
+		case 's': case 'S':
+			imwrite("original.jpg", stream.frame());
+			imwrite("lbp.jpg", stream.display());
+			cout << "Screenshot (operator=" << lbp_names[lbp_operator] << ",radius=" << radius <<",points=" << neighbors << ")" << endl;
+			break;
+		// print the latency of the pipeline stages
+		case 't': case 'T':
+			print_stats(stream.stats());
+			break;
+		default:
+			break;
+		}
+		stream.setOperator(lbp_operator);
+		stream.setRadius(radius);
+		stream.setNeighbors(neighbors);
+	}
+	return 0; // success
 }
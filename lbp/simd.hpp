@@ -0,0 +1,52 @@
+#ifndef SIMD_HPP_
+#define SIMD_HPP_
+
+//! \author philipp <bytefish[at]gmx[dot]de>
+//! \copyright BSD, see LICENSE.
+
+// Internal header: picks up the vector instruction sets the compiler can
+// target. SSE2 and NEON are enabled by the compiler flags, AVX2 is compiled
+// through a function target attribute and only taken when the CPU reports
+// it at runtime.
+
+#include <cv.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define LBP_SSE2 1
+#  include <emmintrin.h>
+#  if defined(__GNUC__)
+#    define LBP_AVX2 1
+#    include <immintrin.h>
+#  endif
+#endif
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#  define LBP_NEON 1
+#  include <arm_neon.h>
+#endif
+
+namespace lbp {
+
+#ifdef LBP_SSE2
+inline bool haveSSE2() {
+#ifdef CV_CPU_SSE2
+	static const bool result = cv::checkHardwareSupport(CV_CPU_SSE2);
+	return result && cv::useOptimized();
+#else
+	return cv::useOptimized();
+#endif
+}
+#endif
+
+#ifdef LBP_AVX2
+inline bool haveAVX2() {
+#ifdef CV_CPU_AVX2
+	static const bool result = cv::checkHardwareSupport(CV_CPU_AVX2);
+#else
+	static const bool result = __builtin_cpu_supports("avx2");
+#endif
+	return result && cv::useOptimized();
+}
+#endif
+
+}
+#endif
@@ -0,0 +1,183 @@
+#include "stream.hpp"
+#include "lbp.hpp"
+
+// milliseconds between two cv::getTickCount() values
+static double elapsed(int64 from, int64 to) {
+	return (to - from) * 1000.0 / getTickFrequency();
+}
+
+lbp::LBPStream::LBPStream(VideoCapture& capture, int queueSize, double scale) :
+	_capture(capture),
+	_scale(scale),
+	_operator(LBP_OPERATOR_ELBP),
+	_radius(1),
+	_neighbors(8),
+	// one slot is filled, one is read by the caller, the rest are queued
+	_slots(max(queueSize, 1) + 2),
+	_current(-1),
+	_running(false),
+	_finished(false) {
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_changed, NULL);
+	resetStats();
+}
+
+lbp::LBPStream::~LBPStream() {
+	stop();
+	pthread_cond_destroy(&_changed);
+	pthread_mutex_destroy(&_mutex);
+}
+
+void* lbp::LBPStream::run(void* self) {
+	static_cast<LBPStream*>(self)->produce();
+	return NULL;
+}
+
+void lbp::LBPStream::start() {
+	if(_running)
+		return;
+	_free.clear();
+	_filled.clear();
+	for(int i = 0; i < (int)_slots.size(); i++)
+		_free.push_back(i);
+	_current = -1;
+	_finished = false;
+	_running = true;
+	resetStats();
+	if(pthread_create(&_thread, NULL, &LBPStream::run, this) != 0) {
+		_running = false;
+		CV_Error(CV_StsError, "Cannot start the capture thread.");
+	}
+}
+
+void lbp::LBPStream::stop() {
+	if(!_running)
+		return;
+	pthread_mutex_lock(&_mutex);
+	_running = false;
+	pthread_cond_broadcast(&_changed);
+	pthread_mutex_unlock(&_mutex);
+	pthread_join(_thread, NULL);
+}
+
+// Grabs and preprocesses frames into free slots until the stream ends or
+// stop() is called.
+void lbp::LBPStream::produce() {
+	for(;;) {
+		pthread_mutex_lock(&_mutex);
+		while(_free.empty() && _running)
+			pthread_cond_wait(&_changed, &_mutex);
+		if(!_running) {
+			pthread_mutex_unlock(&_mutex);
+			return;
+		}
+		int index = _free.front();
+		_free.pop_front();
+		pthread_mutex_unlock(&_mutex);
+
+		Slot& slot = _slots[index];
+		int64 t0 = getTickCount();
+		bool ok = _capture.read(slot.raw) && !slot.raw.empty();
+		int64 t1 = getTickCount();
+		if(ok) {
+			if(slot.raw.channels() == 3)
+				cvtColor(slot.raw, slot.tmp, CV_BGR2GRAY);
+			else if(slot.raw.channels() == 4)
+				cvtColor(slot.raw, slot.tmp, CV_BGRA2GRAY);
+			else
+				slot.raw.copyTo(slot.tmp);
+			GaussianBlur(slot.tmp, slot.tmp, Size(7,7), 5, 3, BORDER_CONSTANT); // tiny bit of smoothing is always a good idea
+			if(_scale != 1.0) {
+				resize(slot.raw, slot.frame, Size(), _scale, _scale);
+				resize(slot.tmp, slot.gray, Size(), _scale, _scale);
+			} else {
+				slot.raw.copyTo(slot.frame);
+				slot.tmp.copyTo(slot.gray);
+			}
+			slot.capture = elapsed(t0, t1);
+			slot.preprocess = elapsed(t1, getTickCount());
+		}
+
+		pthread_mutex_lock(&_mutex);
+		if(ok) {
+			_filled.push_back(index);
+		} else {
+			_free.push_front(index);
+			_finished = true;
+		}
+		pthread_cond_broadcast(&_changed);
+		pthread_mutex_unlock(&_mutex);
+		if(!ok)
+			return;
+	}
+}
+
+bool lbp::LBPStream::next() {
+	if(!_running && !_finished)
+		start();
+	int64 t0 = getTickCount();
+	pthread_mutex_lock(&_mutex);
+	// hand the buffers of the last frame back to the producer
+	if(_current >= 0) {
+		_free.push_back(_current);
+		_current = -1;
+		pthread_cond_broadcast(&_changed);
+	}
+	while(_filled.empty() && !_finished && _running)
+		pthread_cond_wait(&_changed, &_mutex);
+	if(!_filled.empty()) {
+		_current = _filled.front();
+		_filled.pop_front();
+		pthread_cond_broadcast(&_changed);
+	}
+	pthread_mutex_unlock(&_mutex);
+	if(_current < 0)
+		return false;
+	int64 t1 = getTickCount();
+
+	const Slot& slot = _slots[_current];
+	switch(_operator) {
+	case LBP_OPERATOR_OLBP:
+		lbp::OLBP(slot.gray, _lbp);
+		break;
+	case LBP_OPERATOR_VARLBP:
+		lbp::VARLBP(slot.gray, _lbp, _radius, _neighbors);
+		break;
+	default:
+		lbp::ELBP(slot.gray, _lbp, _radius, _neighbors);
+		break;
+	}
+	int64 t2 = getTickCount();
+	// now to show the patterns a normalization is necessary
+	// a simple min-max norm will do the job...
+	normalize(_lbp, _display, 0, 255, NORM_MINMAX, CV_8UC1);
+	int64 t3 = getTickCount();
+
+	_stats.frames++;
+	_stats.capture += slot.capture;
+	_stats.preprocess += slot.preprocess;
+	_stats.wait += elapsed(t0, t1);
+	_stats.lbp += elapsed(t1, t2);
+	_stats.normalize += elapsed(t2, t3);
+	return true;
+}
+
+lbp::LBPStream::Stats lbp::LBPStream::stats() const {
+	Stats result = _stats;
+	if(result.frames > 0) {
+		result.capture /= result.frames;
+		result.preprocess /= result.frames;
+		result.wait /= result.frames;
+		result.lbp /= result.frames;
+		result.normalize /= result.frames;
+		result.fps = result.frames / (elapsed(_started, getTickCount()) / 1000.0);
+	}
+	return result;
+}
+
+void lbp::LBPStream::resetStats() {
+	_stats.frames = 0;
+	_stats.capture = _stats.preprocess = _stats.wait = 0.0;
+	_stats.lbp = _stats.normalize = _stats.fps = 0.0;
+	_started = getTickCount();
+}
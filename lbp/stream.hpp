@@ -0,0 +1,110 @@
+#ifndef STREAM_HPP_
+#define STREAM_HPP_
+
+//! \author philipp <bytefish[at]gmx[dot]de>
+//! \copyright BSD, see LICENSE.
+
+#include <cv.h>
+#include <highgui.h>
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+namespace lbp {
+
+// operators of a LBPStream
+enum {
+	LBP_OPERATOR_ELBP = 0,
+	LBP_OPERATOR_OLBP = 1,
+	LBP_OPERATOR_VARLBP = 2
+};
+
+// Video pipeline which computes a lbp operator on every frame of a
+// cv::VideoCapture. A producer thread grabs and preprocesses the frames
+// (grayscale, Gaussian blur, resize) and hands them over to next() through
+// a bounded queue, so capturing overlaps with the lbp operator. All stage
+// buffers are allocated with the first frame and reused for the rest of
+// the stream.
+class LBPStream {
+public:
+	// per-stage latencies in milliseconds, averaged over frames()
+	struct Stats {
+		int frames;
+		double capture;    // grabbing and decoding a frame
+		double preprocess; // cvtColor, GaussianBlur and resize
+		double wait;       // next() waiting for the producer
+		double lbp;        // the lbp operator
+		double normalize;  // min-max normalization of the codes
+		double fps;        // frames per second since start()
+	};
+
+	//! queueSize frames may wait between the stages, scale resizes the input
+	LBPStream(VideoCapture& capture, int queueSize = 2, double scale = 0.5);
+	~LBPStream();
+
+	//! starts the producer thread
+	void start();
+	//! stops the producer thread, frames in the queue are dropped
+	void stop();
+	//! computes the next frame, returns false at the end of the stream
+	bool next();
+
+	//! the resized color frame of the last next()
+	const Mat& frame() const { return (_current < 0) ? _none : _slots[_current].frame; }
+	//! the preprocessed grayscale frame of the last next()
+	const Mat& gray() const { return (_current < 0) ? _none : _slots[_current].gray; }
+	//! the codes of the last next()
+	const Mat& lbp() const { return _lbp; }
+	//! the codes normalized to CV_8UC1 for display
+	const Mat& display() const { return _display; }
+
+	void setOperator(int op) { _operator = op; }
+	int getOperator() const { return _operator; }
+	void setRadius(int radius) { _radius = radius; }
+	int getRadius() const { return _radius; }
+	void setNeighbors(int neighbors) { _neighbors = neighbors; }
+	int getNeighbors() const { return _neighbors; }
+
+	Stats stats() const;
+	void resetStats();
+
+private:
+	// buffers of one frame in flight
+	struct Slot {
+		Mat raw;   // captured frame
+		Mat frame; // resized color frame
+		Mat gray;  // grayscale, blurred and resized
+		Mat tmp;   // grayscale at full size
+		double capture, preprocess;
+	};
+
+	static void* run(void* self);
+	void produce();
+
+	VideoCapture& _capture;
+	double _scale;
+	int _operator, _radius, _neighbors;
+
+	vector<Slot> _slots;
+	deque<int> _free;   // slots the producer may fill
+	deque<int> _filled; // slots waiting for next()
+	int _current;       // slot of the last next(), -1 before the first
+	bool _running, _finished;
+	pthread_t _thread;
+	mutable pthread_mutex_t _mutex;
+	pthread_cond_t _changed;
+
+	Mat _lbp, _display, _none;
+	Stats _stats; // sums until stats() averages them
+	int64 _started;
+
+	// non-copyable
+	LBPStream(const LBPStream&);
+	LBPStream& operator=(const LBPStream&);
+};
+
+}
+#endif
@@ -0,0 +1,553 @@
+// Regression tests for the lbp operators and histograms on synthetic data.
+// Prints every failed check and returns the number of failures:
+//
+//   lbp_test
+
+#include <cv.h>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "lbp.hpp"
+#include "histogram.hpp"
+#include "gallery.hpp"
+
+using namespace cv;
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const char* name) {
+	if(!condition) {
+		printf("FAILED: %s\n", name);
+		failures++;
+	}
+}
+
+// true if both have the same size, type and content
+static bool equal(const Mat& a, const Mat& b) {
+	if(a.size() != b.size() || a.type() != b.type())
+		return false;
+	for(int i = 0; i < a.rows; i++)
+		if(memcmp(a.ptr(i), b.ptr(i), a.cols*a.elemSize()) != 0)
+			return false;
+	return true;
+}
+
+static Mat random_image(int rows, int cols, int type, double low = 0, double high = 256) {
+	Mat img(rows, cols, type);
+	randu(img, Scalar(low), Scalar(high));
+	return img;
+}
+
+// true if the codes are the same, whatever depth they are written in
+static bool equal_codes(const Mat& codes, const Mat& expected) {
+	Mat a, b;
+	codes.convertTo(a, CV_32S);
+	expected.convertTo(b, CV_32S);
+	return equal(a, b);
+}
+
+// all depths the operators accept
+static const int depths[] = { CV_8S, CV_8U, CV_16S, CV_16U, CV_32S, CV_32F, CV_64F };
+static const int num_depths = 7;
+
+//------------------------------------------------------------------------------
+// reference operators, straight from the definitions
+//------------------------------------------------------------------------------
+
+// lbp::ELBP on the plan of (radius, neighbors) with at<>, as CV_32SC1. The
+// neighbors are interpolated in float and compared with the same tolerance
+// as the kernels.
+template <typename _Tp>
+static Mat elbp_reference(const Mat& src, int radius, int neighbors) {
+	const lbp::SamplingPlan& plan = lbp::SamplingPlan::get(radius, neighbors);
+	const float eps = std::numeric_limits<float>::epsilon();
+	Mat dst(src.rows - 2*radius, src.cols - 2*radius, CV_32SC1);
+	for(int i = radius; i < src.rows - radius; i++) {
+		for(int j = radius; j < src.cols - radius; j++) {
+			int code = 0;
+			for(int n = 0; n < neighbors; n++) {
+				const lbp::SamplingPlan::Sample& s = plan.samples[n];
+				float t = s.w1*src.at<_Tp>(i+s.fy, j+s.fx) + s.w2*src.at<_Tp>(i+s.fy, j+s.cx)
+					+ s.w3*src.at<_Tp>(i+s.cy, j+s.fx) + s.w4*src.at<_Tp>(i+s.cy, j+s.cx);
+				if(DataType<_Tp>::depth == CV_64F)
+					code |= (t - src.at<_Tp>(i, j) > eps) << n;
+				else
+					code |= (t - static_cast<float>(src.at<_Tp>(i, j)) > eps) << n;
+			}
+			dst.at<int>(i - radius, j - radius) = code;
+		}
+	}
+	return dst;
+}
+
+// lbp::OLBP with at<>, the bits in the same order as the kernels
+template <typename _Tp>
+static Mat olbp_reference(const Mat& src) {
+	Mat dst(src.rows - 2, src.cols - 2, CV_8UC1);
+	for(int i = 1; i < src.rows - 1; i++) {
+		for(int j = 1; j < src.cols - 1; j++) {
+			_Tp center = src.at<_Tp>(i, j);
+			unsigned char code = 0;
+			code |= (src.at<_Tp>(i-1, j-1) > center) << 7;
+			code |= (src.at<_Tp>(i-1, j) > center) << 6;
+			code |= (src.at<_Tp>(i-1, j+1) > center) << 5;
+			code |= (src.at<_Tp>(i, j+1) > center) << 4;
+			code |= (src.at<_Tp>(i+1, j+1) > center) << 3;
+			code |= (src.at<_Tp>(i+1, j) > center) << 2;
+			code |= (src.at<_Tp>(i+1, j-1) > center) << 1;
+			code |= (src.at<_Tp>(i, j-1) > center) << 0;
+			dst.at<unsigned char>(i-1, j-1) = code;
+		}
+	}
+	return dst;
+}
+
+static Mat olbp_reference(const Mat& src) {
+	switch(src.depth()) {
+		case CV_8S: return olbp_reference<char>(src);
+		case CV_8U: return olbp_reference<unsigned char>(src);
+		case CV_16S: return olbp_reference<short>(src);
+		case CV_16U: return olbp_reference<unsigned short>(src);
+		case CV_32S: return olbp_reference<int>(src);
+		case CV_32F: return olbp_reference<float>(src);
+	}
+	return olbp_reference<double>(src);
+}
+
+// lbp::VARLBP with at<>, the same on-line mean and variance as the kernels
+template <typename _Tp>
+static Mat varlbp_reference(const Mat& src, int radius, int neighbors) {
+	const lbp::SamplingPlan& plan = lbp::SamplingPlan::get(radius, neighbors);
+	Mat dst(src.rows - 2*radius, src.cols - 2*radius, CV_32FC1);
+	for(int i = radius; i < src.rows - radius; i++) {
+		for(int j = radius; j < src.cols - radius; j++) {
+			float mean = 0.0f, m2 = 0.0f;
+			for(int n = 0; n < neighbors; n++) {
+				const lbp::SamplingPlan::Sample& s = plan.samples[n];
+				float t = s.w1*src.at<_Tp>(i+s.fy, j+s.fx) + s.w2*src.at<_Tp>(i+s.fy, j+s.cx)
+					+ s.w3*src.at<_Tp>(i+s.cy, j+s.fx) + s.w4*src.at<_Tp>(i+s.cy, j+s.cx);
+				float delta = t - mean;
+				mean = mean + delta / (1.0*(n+1));
+				m2 = m2 + delta * (t - mean);
+			}
+			dst.at<float>(i - radius, j - radius) = m2 / (1.0*(neighbors-1));
+		}
+	}
+	return dst;
+}
+
+//------------------------------------------------------------------------------
+// tests
+//------------------------------------------------------------------------------
+
+// regions at the crop size and regions that need scaling, interleaved, so
+// every stripe sees both; the frame must be untouched
+static void test_histograms_mixed_regions() {
+	Mat frame = random_image(120, 160, CV_8UC1);
+	Mat original = frame.clone();
+	Size cropSize(40, 40);
+	vector<Rect> rects;
+	for(int i = 0; i < 16; i++) {
+		int x = (i*23) % 100, y = (i*17) % 70;
+		if(i % 2 == 0)
+			rects.push_back(Rect(x, y, cropSize.width, cropSize.height));
+		else
+			rects.push_back(Rect(x, y, 30 + i, 45 - i));
+	}
+	for(int threads = 1; threads <= 4; threads += 3) {
+		lbp::setNumThreads(threads);
+		Mat features;
+		lbp::spatial_lbp_histograms(frame, rects, features, cropSize, 1, 8, 4, 4);
+		check(equal(frame, original), "spatial_lbp_histograms leaves the frame unchanged");
+		bool same = true;
+		for(size_t i = 0; i < rects.size(); i++) {
+			Mat crop, hist;
+			if(rects[i].size() == cropSize)
+				crop = frame(rects[i]).clone();
+			else
+				resize(frame(rects[i]), crop, cropSize);
+			lbp::spatial_lbp_histogram(crop, hist, 1, 8, 4, 4);
+			same = same && equal(hist, features.row(static_cast<int>(i)));
+		}
+		check(same, "spatial_lbp_histograms of native and scaled regions");
+	}
+	lbp::setNumThreads(0);
+}
+
+// overlapping cells through the integral histogram (uniform codes, step 4
+// of window 16) and counted directly (co-prime step, 16 bit codes),
+// against the histograms of the cells one by one
+static void test_spatial_histogram_overlap() {
+	const int cases[][5] = { {80, CV_8UC1, 59, 16, 12}, {40, CV_8UC1, 256, 8, 1}, {40, CV_16UC1, 65536, 7, 3} };
+	for(int c = 0; c < 3; c++) {
+		int size = cases[c][0], type = cases[c][1], numPatterns = cases[c][2], window = cases[c][3], overlap = cases[c][4];
+		Mat codes32(size, size + 10, CV_32SC1), codes;
+		RNG rng(c);
+		for(int i = 0; i < codes32.rows; i++)
+			for(int j = 0; j < codes32.cols; j++)
+				codes32.at<int>(i, j) = rng.uniform(0, numPatterns);
+		codes32.convertTo(codes, type);
+		Mat hist;
+		lbp::spatial_histogram(codes, hist, numPatterns, Size(window, window), overlap);
+		int step = window - overlap;
+		int offset = 0;
+		bool same = true;
+		for(int x = 0; x < codes.cols - window; x += step) {
+			for(int y = 0; y < codes.rows - window; y += step) {
+				Mat cell = lbp::histogram(codes(Rect(x, y, window, window)), numPatterns);
+				same = same && equal(cell, hist.colRange(offset, offset + numPatterns));
+				offset += numPatterns;
+			}
+		}
+		check(same && offset == hist.cols, "spatial_histogram with overlapping cells");
+	}
+}
+
+// asks for more pyramid levels than the largest radius fits into: the
+// levels that fit must match lbp::ELBP on the pyramid, the rest is left out
+static void test_elbp_pyramid_levels() {
+	Mat img = random_image(40, 48, CV_8UC1);
+	vector<int> radii, neighbors;
+	radii.push_back(1); neighbors.push_back(8);
+	radii.push_back(3); neighbors.push_back(16);
+	vector<Mat> dst;
+	lbp::ELBP(img, dst, radii, neighbors, 6);
+	// 40 x 48, 20 x 24, 10 x 12, 5 x 6 is too small for radius 3
+	check(dst.size() == 3*radii.size(), "ELBP pyramid stops at the last level that fits");
+	vector<Mat> pyramid;
+	buildPyramid(img, pyramid, 2);
+	bool same = true;
+	for(size_t l = 0; l < pyramid.size() && l*radii.size() < dst.size(); l++)
+		for(size_t k = 0; k < radii.size(); k++)
+			same = same && equal(dst[l*radii.size()+k], lbp::ELBP(pyramid[l], radii[k], neighbors[k]));
+	check(same, "ELBP pyramid levels match lbp::ELBP");
+	bool thrown = false;
+	try {
+		Mat signed_img;
+		img.convertTo(signed_img, CV_8S, 1, -128);
+		lbp::ELBP(signed_img, dst, radii, neighbors, 2);
+	} catch(const cv::Exception&) {
+		thrown = true;
+	}
+	check(thrown, "ELBP pyramid rejects CV_8S input");
+}
+
+// OLBP with the vector kernels on and off: every depth over its full range
+// and on few levels, so many neighbors equal the center, and widths that
+// leave a tail behind the 8, 16 and 32 codes of the vector iterations
+static void test_olbp_simd() {
+	const double ranges[][2] = { {-128, 128}, {0, 256}, {-32768, 32768}, {0, 65536}, {-100000, 100000}, {-1000, 1000}, {-1000, 1000} };
+	const int widths[] = { 1, 7, 15, 16, 17, 31, 33, 47, 65, 99 };
+	for(int optimized = 1; optimized >= 0; optimized--) {
+		setUseOptimized(optimized != 0);
+		for(int d = 0; d < num_depths; d++) {
+			for(int w = 0; w < 10; w++) {
+				int type = CV_MAKETYPE(depths[d], 1);
+				Mat full = random_image(9, widths[w] + 2, type, ranges[d][0], ranges[d][1]);
+				Mat ties = random_image(9, widths[w] + 2, type, 0, 3);
+				Mat codes;
+				lbp::OLBP(full, codes);
+				check(equal(codes, olbp_reference(full)), optimized ? "OLBP with SIMD" : "OLBP without SIMD");
+				lbp::OLBP(ties, codes);
+				check(equal(codes, olbp_reference(ties)), optimized ? "OLBP with SIMD, ties" : "OLBP without SIMD, ties");
+			}
+		}
+	}
+	setUseOptimized(true);
+}
+
+// Every bit where the fixed-point codes differ from the float codes must
+// belong to a neighbor, interpolated in double, within the band stated in
+// lbp.hpp: 1.5 gray levels of the center for 8 bit input, 3 for 16 bit.
+template <typename _Tp>
+static bool fixed_point_within_band(const Mat& src, int radius, int neighbors, double band) {
+	Mat fixed, exact;
+	lbp::setUseFixedPoint(true);
+	lbp::ELBP(src, fixed, radius, neighbors);
+	lbp::setUseFixedPoint(false);
+	lbp::ELBP(src, exact, radius, neighbors);
+	fixed.convertTo(fixed, CV_32S);
+	exact.convertTo(exact, CV_32S);
+	const lbp::SamplingPlan& plan = lbp::SamplingPlan::get(radius, neighbors);
+	for(int i = 0; i < fixed.rows; i++) {
+		for(int j = 0; j < fixed.cols; j++) {
+			int diff = fixed.at<int>(i, j) ^ exact.at<int>(i, j);
+			for(int n = 0; n < neighbors; n++) {
+				if(!(diff & (1 << n)))
+					continue;
+				const lbp::SamplingPlan::Sample& s = plan.samples[n];
+				int y = i + radius, x = j + radius;
+				double t = s.w1*src.at<_Tp>(y+s.fy, x+s.fx) + s.w2*src.at<_Tp>(y+s.fy, x+s.cx)
+					+ s.w3*src.at<_Tp>(y+s.cy, x+s.fx) + s.w4*src.at<_Tp>(y+s.cy, x+s.cx);
+				if(abs(t - src.at<_Tp>(y, x)) > band)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void test_fixed_point_band() {
+	const int configs[][2] = { {1, 8}, {2, 8}, {2, 12}, {2, 16}, {3, 24}, {4, 31} };
+	for(int k = 0; k < 6; k++) {
+		int radius = configs[k][0], neighbors = configs[k][1];
+		check(fixed_point_within_band<unsigned char>(random_image(64, 80, CV_8UC1), radius, neighbors, 1.5), "fixed point, 8 bit");
+		check(fixed_point_within_band<char>(random_image(64, 80, CV_8SC1, -128, 128), radius, neighbors, 1.5), "fixed point, signed 8 bit");
+		check(fixed_point_within_band<unsigned short>(random_image(64, 80, CV_16UC1, 0, 65536), radius, neighbors, 3.0), "fixed point, 16 bit");
+		check(fixed_point_within_band<short>(random_image(64, 80, CV_16SC1, -32768, 32768), radius, neighbors, 3.0), "fixed point, signed 16 bit");
+		// smooth input puts many neighbors close to the center
+		Mat smooth = random_image(64, 80, CV_8UC1, 100, 104);
+		check(fixed_point_within_band<unsigned char>(smooth, radius, neighbors, 1.5), "fixed point, 8 bit, smooth");
+	}
+}
+
+// the operators templated on (radius, neighbors) against the references
+template <typename _Tp>
+static void check_fixed_operators(const Mat& src) {
+	Mat codes, var;
+	lbp::ELBP_<_Tp, 1, 8>(src, codes);
+	check(equal_codes(codes, elbp_reference<_Tp>(src, 1, 8)), "ELBP_<1,8>");
+	lbp::ELBP_<_Tp, 2, 8>(src, codes);
+	check(equal_codes(codes, elbp_reference<_Tp>(src, 2, 8)), "ELBP_<2,8>");
+	lbp::ELBP_<_Tp, 2, 16>(src, codes);
+	check(equal_codes(codes, elbp_reference<_Tp>(src, 2, 16)), "ELBP_<2,16>");
+	lbp::ELBP_<_Tp, 3, 24>(src, codes);
+	check(equal_codes(codes, elbp_reference<_Tp>(src, 3, 24)), "ELBP_<3,24>");
+	lbp::VARLBP_<_Tp, 1, 8>(src, var);
+	check(equal(var, varlbp_reference<_Tp>(src, 1, 8)), "VARLBP_<1,8>");
+	lbp::VARLBP_<_Tp, 2, 16>(src, var);
+	check(equal(var, varlbp_reference<_Tp>(src, 2, 16)), "VARLBP_<2,16>");
+	lbp::VARLBP_<_Tp, 3, 24>(src, var);
+	check(equal(var, varlbp_reference<_Tp>(src, 3, 24)), "VARLBP_<3,24>");
+	// the runtime operators take the same kernels for these configurations
+	// and the generic ones for others
+	lbp::ELBP(src, codes, 2, 16);
+	check(equal_codes(codes, elbp_reference<_Tp>(src, 2, 16)), "ELBP(2,16)");
+	lbp::ELBP(src, codes, 3, 8);
+	check(equal_codes(codes, elbp_reference<_Tp>(src, 3, 8)), "ELBP(3,8)");
+	lbp::ELBP(src, codes, 2, 12);
+	check(equal_codes(codes, elbp_reference<_Tp>(src, 2, 12)), "ELBP(2,12)");
+}
+
+static void test_fixed_operators() {
+	for(int d = 0; d < num_depths; d++) {
+		Mat src = random_image(37, 75, CV_MAKETYPE(depths[d], 1), 0, 100);
+		switch(depths[d]) {
+			case CV_8S: check_fixed_operators<char>(src); break;
+			case CV_8U: check_fixed_operators<unsigned char>(src); break;
+			case CV_16S: check_fixed_operators<short>(src); break;
+			case CV_16U: check_fixed_operators<unsigned short>(src); break;
+			case CV_32S: check_fixed_operators<int>(src); break;
+			case CV_32F: check_fixed_operators<float>(src); break;
+			case CV_64F: check_fixed_operators<double>(src); break;
+		}
+	}
+}
+
+// the operators on one thread and in bands of various sizes on four
+static void test_threads_and_grain_sizes() {
+	Mat src = random_image(131, 97, CV_8UC1);
+	Mat fsrc = random_image(131, 97, CV_32FC1);
+	lbp::Mapping mapping(16, lbp::LBP_MAPPING_U2);
+	lbp::setNumThreads(1);
+	Mat olbp = lbp::OLBP(src), elbp = lbp::ELBP(src, 2, 16), var = lbp::VARLBP(fsrc, 3, 24), mapped = lbp::ELBP(src, mapping, 2);
+	const int grains[] = { 1, 3, 16, 1000 };
+	for(int g = 0; g < 4; g++) {
+		lbp::setNumThreads(4);
+		lbp::setGrainSize(grains[g]);
+		check(equal(lbp::OLBP(src), olbp), "OLBP on four threads");
+		check(equal(lbp::ELBP(src, 2, 16), elbp), "ELBP on four threads");
+		check(equal(lbp::VARLBP(fsrc, 3, 24), var), "VARLBP on four threads");
+		check(equal(lbp::ELBP(src, mapping, 2), mapped), "mapped ELBP on four threads");
+	}
+	lbp::setNumThreads(0);
+	lbp::setGrainSize(16);
+}
+
+// With a border the interior must equal the operator without one and the
+// whole image the operator on a copyMakeBorder copy, for every mode
+static void test_border_modes() {
+	const int modes[] = { BORDER_REPLICATE, BORDER_REFLECT, BORDER_REFLECT_101, BORDER_WRAP, BORDER_CONSTANT };
+	Mat src = random_image(23, 31, CV_8UC1);
+	Mat fsrc = random_image(23, 31, CV_32FC1);
+	lbp::Mapping mapping(8, lbp::LBP_MAPPING_RIU2);
+	for(int m = 0; m < 5; m++) {
+		int mode = modes[m];
+		Mat padded, codes;
+		copyMakeBorder(src, padded, 1, 1, 1, 1, mode, Scalar(0));
+		lbp::OLBP(src, codes, mode);
+		check(equal(codes, lbp::OLBP(padded)), "OLBP with a border");
+		check(equal(codes(Rect(1, 1, src.cols-2, src.rows-2)), lbp::OLBP(src)), "OLBP interior");
+		for(int radius = 1; radius <= 3; radius++) {
+			copyMakeBorder(src, padded, radius, radius, radius, radius, mode, Scalar(0));
+			Rect interior(radius, radius, src.cols-2*radius, src.rows-2*radius);
+			lbp::ELBP(src, codes, radius, 8*radius, mode);
+			check(equal(codes, lbp::ELBP(padded, radius, 8*radius)), "ELBP with a border");
+			check(equal(codes(interior), lbp::ELBP(src, radius, 8*radius)), "ELBP interior");
+			lbp::ELBP(src, codes, mapping, radius, mode);
+			check(equal(codes, lbp::ELBP(padded, mapping, radius)), "mapped ELBP with a border");
+			check(equal(codes(interior), lbp::ELBP(src, mapping, radius)), "mapped ELBP interior");
+			copyMakeBorder(fsrc, padded, radius, radius, radius, radius, mode, Scalar(0));
+			lbp::VARLBP(fsrc, codes, radius, 8, mode);
+			check(equal(codes, lbp::VARLBP(padded, radius, 8)), "VARLBP with a border");
+			check(equal(codes(interior), lbp::VARLBP(fsrc, radius, 8)), "VARLBP interior");
+		}
+	}
+}
+
+// the multi-scale operator computes its scales in strips of rows, they
+// must equal one lbp::ELBP call per scale on one thread and on four, with
+// and without fixed point
+static void test_multi_scale() {
+	Mat src = random_image(53, 61, CV_8UC1);
+	const int r[] = { 1, 2, 3, 5 }, p[] = { 8, 16, 24, 12 };
+	vector<int> radii(r, r + 4), neighbors(p, p + 4);
+	vector<lbp::Mapping> mappings;
+	for(int k = 0; k < 4; k++)
+		mappings.push_back(lbp::Mapping(neighbors[k], lbp::LBP_MAPPING_U2));
+	for(int fixed = 0; fixed <= 1; fixed++) {
+		lbp::setUseFixedPoint(fixed != 0);
+		for(int threads = 1; threads <= 4; threads += 3) {
+			lbp::setNumThreads(threads);
+			lbp::setGrainSize(threads == 1 ? 16 : 3);
+			vector<Mat> scales, mapped;
+			lbp::ELBP(src, scales, radii, neighbors);
+			lbp::ELBP(src, mapped, radii, mappings);
+			bool same = scales.size() == 4 && mapped.size() == 4;
+			for(int k = 0; same && k < 4; k++) {
+				same = equal(scales[k], lbp::ELBP(src, radii[k], neighbors[k]))
+					&& equal(mapped[k], lbp::ELBP(src, mappings[k], radii[k]));
+			}
+			check(same, "multi-scale ELBP equals ELBP per scale");
+		}
+	}
+	lbp::setUseFixedPoint(false);
+	lbp::setNumThreads(0);
+	lbp::setGrainSize(16);
+}
+
+// the default code depth: the smallest of CV_8U, CV_16U and CV_32S that
+// holds the codes, decided by the mapping if there is one
+static void test_code_depths() {
+	Mat src = random_image(30, 40, CV_8UC1);
+	check(lbp::ELBP(src, 1, 8).type() == CV_8UC1, "ELBP of 8 neighbors is CV_8UC1");
+	check(lbp::ELBP(src, 2, 12).type() == CV_16UC1, "ELBP of 12 neighbors is CV_16UC1");
+	check(lbp::ELBP(src, 2, 16).type() == CV_16UC1, "ELBP of 16 neighbors is CV_16UC1");
+	check(lbp::ELBP(src, 3, 24).type() == CV_32SC1, "ELBP of 24 neighbors is CV_32SC1");
+	check(lbp::ELBP(src, lbp::Mapping(16, lbp::LBP_MAPPING_U2), 2).type() == CV_8UC1, "u2 codes of 16 neighbors are CV_8UC1");
+	check(lbp::ELBP(src, lbp::Mapping(24, lbp::LBP_MAPPING_U2), 3).type() == CV_16UC1, "u2 codes of 24 neighbors are CV_16UC1");
+	check(lbp::ELBP(src, lbp::Mapping(24, lbp::LBP_MAPPING_RIU2), 3).type() == CV_8UC1, "riu2 codes of 24 neighbors are CV_8UC1");
+	check(lbp::ELBP(src, lbp::Mapping(16, lbp::LBP_MAPPING_NONE), 2).type() == CV_16UC1, "plain mapped codes of 16 neighbors are CV_16UC1");
+	vector<int> radii, neighbors;
+	radii.push_back(1); neighbors.push_back(8);
+	radii.push_back(2); neighbors.push_back(16);
+	radii.push_back(3); neighbors.push_back(24);
+	vector<Mat> scales;
+	lbp::ELBP(src, scales, radii, neighbors);
+	check(scales[0].type() == CV_8UC1 && scales[1].type() == CV_16UC1 && scales[2].type() == CV_32SC1, "multi-scale ELBP uses the default depths");
+	// a forced depth writes the same codes, if they fit
+	Mat wide = lbp::ELBP(src, 1, 8, lbp::LBP_BORDER_NONE, CV_32S);
+	check(wide.type() == CV_32SC1 && equal_codes(wide, lbp::ELBP(src, 1, 8)), "ELBP forced to CV_32S");
+	bool thrown = false;
+	try {
+		lbp::ELBP(src, 2, 16, lbp::LBP_BORDER_NONE, CV_8U);
+	} catch(const cv::Exception&) {
+		thrown = true;
+	}
+	check(thrown, "ELBP rejects a depth too small for the codes");
+}
+
+// true if the search returned k distinct templates, each at the distance
+// it reports, and the distances are the k smallest of a brute-force loop
+// over lbp::chi_square, up to float rounding
+static bool nearest(const vector<Mat>& templates, const Mat& query, int k, const vector<int>& indices, const vector<double>& distances) {
+	vector<double> brute;
+	for(size_t i = 0; i < templates.size(); i++)
+		brute.push_back(lbp::chi_square(query, templates[i]));
+	vector<double> sorted(brute);
+	std::sort(sorted.begin(), sorted.end());
+	if((int)indices.size() != k || (int)distances.size() != k)
+		return false;
+	vector<int> unique(indices);
+	std::sort(unique.begin(), unique.end());
+	if(std::unique(unique.begin(), unique.end()) != unique.end())
+		return false;
+	for(int i = 0; i < k; i++) {
+		double tolerance = 1e-5 * sorted[i];
+		if(abs(distances[i] - sorted[i]) > tolerance || abs(brute[indices[i]] - distances[i]) > tolerance)
+			return false;
+	}
+	return true;
+}
+
+// LBPHGallery::search without and with the coarse prefilter, always with
+// early abandoning, against a brute-force loop. More than 4096 templates,
+// so the search runs in several parallel bands.
+static void test_gallery_search() {
+	const int count = 9000, dims = 236, k = 3;
+	RNG rng(5);
+	vector<Mat> templates;
+	vector<int> labels;
+	// three noisy copies of every subject, so the k nearest of a query
+	// close to a subject are far closer than the rest and the prefilter
+	// has something to prune
+	Mat subject(1, dims, CV_32FC1);
+	for(int i = 0; i < count; i++) {
+		if(i % 3 == 0) {
+			for(int j = 0; j < dims; j++)
+				subject.at<float>(0, j) = static_cast<float>(rng.uniform(0, 20));
+		}
+		Mat hist(1, dims, CV_32FC1);
+		for(int j = 0; j < dims; j++)
+			hist.at<float>(0, j) = subject.at<float>(0, j) + rng.uniform(0, 2);
+		templates.push_back(hist);
+		labels.push_back(i / 3);
+	}
+	lbp::LBPHGallery exhaustive, prefiltered(4);
+	exhaustive.add(templates, labels);
+	prefiltered.add(templates, labels);
+	for(int q = 0; q < 4; q++) {
+		// one query close to a subject, the others random
+		Mat query(1, dims, CV_32FC1);
+		for(int j = 0; j < dims; j++)
+			query.at<float>(0, j) = (q == 0) ? templates[1234].at<float>(0, j) + rng.uniform(0, 2) : static_cast<float>(rng.uniform(0, 20));
+		vector<int> indices, single;
+		vector<double> distances, singleDistances;
+		for(int threads = 1; threads <= 4; threads += 3) {
+			setNumThreads(threads);
+			exhaustive.search(query, k, indices, distances);
+			check(nearest(templates, query, k, indices, distances), "gallery search");
+			if(threads == 1) {
+				single = indices;
+				singleDistances = distances;
+			} else {
+				check(indices == single && distances == singleDistances, "gallery search on one thread and on four");
+			}
+			prefiltered.search(query, k, indices, distances);
+			check(nearest(templates, query, k, indices, distances), "gallery search with the coarse prefilter");
+			check(indices == single, "gallery search with and without the coarse prefilter");
+		}
+		if(q == 0)
+			check(exhaustive.predict(query) == labels[1234] && prefiltered.predict(query) == labels[1234], "gallery predict");
+	}
+	setNumThreads(-1);
+}
+
+int main() {
+	test_histograms_mixed_regions();
+	test_spatial_histogram_overlap();
+	test_elbp_pyramid_levels();
+	test_fixed_operators();
+	test_olbp_simd();
+	test_fixed_point_band();
+	test_threads_and_grain_sizes();
+	test_border_modes();
+	test_code_depths();
+	test_multi_scale();
+	test_gallery_search();
+	printf("%d failure(s)\n", failures);
+	return failures;
+}
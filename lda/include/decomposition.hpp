@@ -19,6 +19,8 @@
 #define __DECOMPOSITION_HPP__
 
 #include "opencv2/opencv.hpp"
+#include "helper.hpp"
+#include <float.h>
 
 using namespace cv;
 using namespace std;
@@ -38,47 +40,38 @@ using namespace std;
  * guarantees, expressed or implied, about its quality, reliability, or any
  * other characteristic.
  *
+ * Symmetric matrices are detected with cv::isSymmetric and decomposed by
+ * a Householder reduction to tridiagonal form and the implicit QL method
+ * (JAMA's tred2 and tql2), which is several times faster than the general
+ * Hessenberg and real Schur path (orthes and hqr2) and gives real,
+ * orthonormal eigenvectors with the eigenvalues in ascending order.
+ *
+ * If only num_components > 0 eigenpairs are asked for, the largest are
+ * returned in descending order. For symmetric matrices only their
+ * eigenvectors are computed: QL without accumulating the rotations gives
+ * all eigenvalues, inverse iteration on the tridiagonal matrix gives the
+ * eigenvectors of the largest ones and these are transformed back with the
+ * Householder vectors. The reduction is still O(n^3), but this avoids
+ * accumulating the QL rotations and the full n x n eigenvector matrix.
+ *
+ * H and V are contiguous row-major Mat_<double> and all vectors live in
+ * one workspace, so nothing is allocated when the same instance decomposes
+ * further matrices of the same size. eigenvalues() and eigenvectors()
+ * return headers to the results without copying them, like cv::PCA; they
+ * are overwritten by the next compute, clone them to keep them.
  */
 
 class EigenvalueDecomposition {
 private:
 	int n;
+	int num_components; // number of eigenpairs returned, n unless only the largest are computed
+	bool descending; // num_components was given, so the eigenpairs are sorted descending
 	double cdivr, cdivi;
 
+	Mat_<double> H, V; // n x n
+	Mat_<double> Z; // num_components x n, eigenvectors of the tridiagonal matrix
+	Mat_<double> work; // d, e, ort and the vectors of tridiagonal_eigenvectors by row
 	double *d, *e, *ort;
-	double **V, **H;
-
-	template<typename _Tp>
-	_Tp *alloc_1d(int m) {
-		return new _Tp[m];
-	}
-
-	template<typename _Tp>
-	_Tp *alloc_1d(int m, _Tp val) {
-		_Tp *arr = alloc_1d<_Tp> (m);
-		for (int i = 0; i < m; i++)
-			arr[i] = val;
-		return arr;
-	}
-
-	template<typename _Tp>
-	_Tp **alloc_2d(int m, int n) {
-		_Tp **arr = new _Tp*[m];
-		for (int i = 0; i < m; i++)
-			arr[i] = new _Tp[n];
-		return arr;
-	}
-
-	template<typename _Tp>
-	_Tp **alloc_2d(int m, int n, _Tp val) {
-		_Tp **arr = alloc_2d<_Tp> (m, n);
-		for (int i = 0; i < m; i++) {
-			for (int j = 0; j < n; j++) {
-				arr[i][j] = val;
-			}
-		}
-		return arr;
-	}
 
 	void cdiv(double xr, double xi, double yr, double yi) {
 		double r, d;
@@ -95,6 +88,451 @@ private:
 		}
 	}
 
+	// sqrt(a^2 + b^2) without under/overflow.
+	static double hypot(double a, double b) {
+		double r;
+		if (abs(a) > abs(b)) {
+			r = b / a;
+			r = abs(a) * sqrt(1 + r * r);
+		} else if (b != 0) {
+			r = a / b;
+			r = abs(b) * sqrt(1 + r * r);
+		} else {
+			r = 0.0;
+		}
+		return r;
+	}
+
+	// Symmetric Householder reduction to tridiagonal form.
+	//
+	// Without accumulate the transformations are not accumulated: V keeps
+	// the Householder vectors above the diagonal (column i holds the one of
+	// step i) with their h in ort, d the diagonal and e the subdiagonal.
+
+	void tred2(bool accumulate) {
+
+		//  This is derived from the Algol procedures tred2 by
+		//  Bowdler, Martin, Reinsch, and Wilkinson, Handbook for
+		//  Auto. Comp., Vol.ii-Linear Algebra, and the corresponding
+		//  Fortran subroutine in EISPACK.
+
+		for (int j = 0; j < n; j++) {
+			d[j] = V[n - 1][j];
+		}
+
+		// Householder reduction to tridiagonal form.
+
+		for (int i = n - 1; i > 0; i--) {
+
+			// Scale to avoid under/overflow.
+
+			double scale = 0.0;
+			double h = 0.0;
+			for (int k = 0; k < i; k++) {
+				scale = scale + abs(d[k]);
+			}
+			if (scale == 0.0) {
+				e[i] = d[i - 1];
+				for (int j = 0; j < i; j++) {
+					d[j] = V[i - 1][j];
+					V[i][j] = 0.0;
+					V[j][i] = 0.0;
+				}
+			} else {
+
+				// Generate Householder vector.
+
+				for (int k = 0; k < i; k++) {
+					d[k] /= scale;
+					h += d[k] * d[k];
+				}
+				double f = d[i - 1];
+				double g = sqrt(h);
+				if (f > 0) {
+					g = -g;
+				}
+				e[i] = scale * g;
+				h = h - f * g;
+				d[i - 1] = f - g;
+				for (int j = 0; j < i; j++) {
+					e[j] = 0.0;
+				}
+
+				// Apply similarity transformation to remaining columns.
+
+				for (int j = 0; j < i; j++) {
+					f = d[j];
+					V[j][i] = f;
+					g = e[j] + V[j][j] * f;
+					for (int k = j + 1; k <= i - 1; k++) {
+						g += V[k][j] * d[k];
+						e[k] += V[k][j] * f;
+					}
+					e[j] = g;
+				}
+				f = 0.0;
+				for (int j = 0; j < i; j++) {
+					e[j] /= h;
+					f += e[j] * d[j];
+				}
+				double hh = f / (h + h);
+				for (int j = 0; j < i; j++) {
+					e[j] -= hh * d[j];
+				}
+				for (int j = 0; j < i; j++) {
+					f = d[j];
+					g = e[j];
+					for (int k = j; k <= i - 1; k++) {
+						V[k][j] -= (f * e[k] + g * d[k]);
+					}
+					d[j] = V[i - 1][j];
+					V[i][j] = 0.0;
+				}
+			}
+			d[i] = h;
+		}
+
+		if (!accumulate) {
+			for (int i = 0; i < n; i++) {
+				ort[i] = d[i];
+				d[i] = V[i][i];
+			}
+			e[0] = 0.0;
+			return;
+		}
+
+		// Accumulate transformations.
+
+		for (int i = 0; i < n - 1; i++) {
+			V[n - 1][i] = V[i][i];
+			V[i][i] = 1.0;
+			double h = d[i + 1];
+			if (h != 0.0) {
+				for (int k = 0; k <= i; k++) {
+					d[k] = V[k][i + 1] / h;
+				}
+				for (int j = 0; j <= i; j++) {
+					double g = 0.0;
+					for (int k = 0; k <= i; k++) {
+						g += V[k][i + 1] * V[k][j];
+					}
+					for (int k = 0; k <= i; k++) {
+						V[k][j] -= g * d[k];
+					}
+				}
+			}
+			for (int k = 0; k <= i; k++) {
+				V[k][i + 1] = 0.0;
+			}
+		}
+		for (int j = 0; j < n; j++) {
+			d[j] = V[n - 1][j];
+			V[n - 1][j] = 0.0;
+		}
+		V[n - 1][n - 1] = 1.0;
+		e[0] = 0.0;
+	}
+
+	// Symmetric tridiagonal QL algorithm.
+	//
+	// Without vectors only the eigenvalues are computed and V is untouched.
+
+	void tql2(bool vectors) {
+
+		//  This is derived from the Algol procedures tql2, by
+		//  Bowdler, Martin, Reinsch, and Wilkinson, Handbook for
+		//  Auto. Comp., Vol.ii-Linear Algebra, and the corresponding
+		//  Fortran subroutine in EISPACK.
+
+		for (int i = 1; i < n; i++) {
+			e[i - 1] = e[i];
+		}
+		e[n - 1] = 0.0;
+
+		double f = 0.0;
+		double tst1 = 0.0;
+		double eps = pow(2.0, -52.0);
+		for (int l = 0; l < n; l++) {
+
+			// Find small subdiagonal element
+
+			tst1 = max(tst1, abs(d[l]) + abs(e[l]));
+			int m = l;
+			while (m < n) {
+				if (abs(e[m]) <= eps * tst1) {
+					break;
+				}
+				m++;
+			}
+
+			// If m == l, d[l] is an eigenvalue,
+			// otherwise, iterate.
+
+			if (m > l) {
+				do {
+
+					// Compute implicit shift
+
+					double g = d[l];
+					double p = (d[l + 1] - g) / (2.0 * e[l]);
+					double r = hypot(p, 1.0);
+					if (p < 0) {
+						r = -r;
+					}
+					d[l] = e[l] / (p + r);
+					d[l + 1] = e[l] * (p + r);
+					double dl1 = d[l + 1];
+					double h = g - d[l];
+					for (int i = l + 2; i < n; i++) {
+						d[i] -= h;
+					}
+					f = f + h;
+
+					// Implicit QL transformation.
+
+					p = d[m];
+					double c = 1.0;
+					double c2 = c;
+					double c3 = c;
+					double el1 = e[l + 1];
+					double s = 0.0;
+					double s2 = 0.0;
+					for (int i = m - 1; i >= l; i--) {
+						c3 = c2;
+						c2 = c;
+						s2 = s;
+						g = c * e[i];
+						h = c * p;
+						r = hypot(p, e[i]);
+						e[i + 1] = s * r;
+						s = e[i] / r;
+						c = p / r;
+						p = c * d[i] - s * g;
+						d[i + 1] = h + s * (c * g + s * d[i]);
+
+						// Accumulate transformation.
+
+						if (vectors) {
+							for (int k = 0; k < n; k++) {
+								h = V[k][i + 1];
+								V[k][i + 1] = s * V[k][i] + c * h;
+								V[k][i] = c * V[k][i] - s * h;
+							}
+						}
+					}
+					p = -s * s2 * c3 * el1 * e[l] / dl1;
+					e[l] = s * p;
+					d[l] = c * p;
+
+					// Check for convergence.
+
+				} while (abs(e[l]) > eps * tst1);
+			}
+			d[l] = d[l] + f;
+			e[l] = 0.0;
+		}
+
+		// Sort eigenvalues and corresponding vectors.
+
+		for (int i = 0; i < n - 1; i++) {
+			int k = i;
+			double p = d[i];
+			for (int j = i + 1; j < n; j++) {
+				if (d[j] < p) {
+					k = j;
+					p = d[j];
+				}
+			}
+			if (k != i) {
+				d[k] = d[i];
+				d[i] = p;
+				if (vectors) {
+					for (int j = 0; j < n; j++) {
+						p = V[j][i];
+						V[j][i] = V[j][k];
+						V[j][k] = p;
+					}
+				}
+			}
+		}
+	}
+
+	// Eigenvectors of the num_components largest eigenvalues of a symmetric
+	// matrix reduced by tred2(false), by inverse iteration on the tridiagonal
+	// matrix. Eigenvectors of close eigenvalues are orthogonalized against
+	// each other. The eigenvalues end up in d in descending order and the
+	// eigenvectors in the first num_components columns of V.
+
+	void tridiagonal_eigenvectors() {
+		int k = num_components;
+		double *diag = work[3];
+		double *off = work[4];
+		for (int i = 0; i < n; i++) {
+			diag[i] = d[i];
+		}
+		for (int i = 0; i < n - 1; i++) {
+			off[i] = e[i + 1];
+		}
+		off[n - 1] = 0.0;
+		// all eigenvalues, ascending
+		tql2(false);
+		double tnorm = 0.0;
+		for (int i = 0; i < n; i++) {
+			tnorm = max(tnorm, abs(diag[i]) + abs(off[i]) + (i > 0 ? abs(off[i - 1]) : 0.0));
+		}
+		double eps = pow(2.0, -52.0);
+		if (tnorm == 0.0) {
+			tnorm = 1.0;
+		}
+		double pertol = 10.0 * eps * tnorm;
+		double ortol = 1e-3 * tnorm;
+		// LU factors of T - lambda*I with partial pivoting: the three
+		// diagonals of U, the multipliers and the row swaps
+		double *u0 = work[5];
+		double *u1 = work[6];
+		double *u2 = work[7];
+		double *mult = work[8];
+		double *swapped = work[9]; // 1 where the rows were swapped
+		double *lambda = work[10];
+		Z.create(k, n);
+		RNG rng(0x7fffffff); // fixed seed, so results are reproducible
+		int first = 0; // first eigenvector of the current cluster
+		for (int j = 0; j < k; j++) {
+			lambda[j] = d[n - 1 - j];
+			if (j > 0) {
+				// separate equal eigenvalues, so every one gets its own vector
+				if (lambda[j - 1] - lambda[j] < pertol) {
+					lambda[j] = lambda[j - 1] - pertol;
+				}
+				if (lambda[j - 1] - lambda[j] > ortol) {
+					first = j;
+				}
+			}
+			// factorize T - lambda*I
+			double a = diag[0] - lambda[j];
+			double b = off[0];
+			double c = 0.0;
+			for (int i = 0; i < n - 1; i++) {
+				double sub = off[i];
+				double nd = diag[i + 1] - lambda[j];
+				double nsup = off[i + 1];
+				if (abs(a) >= abs(sub)) {
+					if (a == 0.0) {
+						a = pertol;
+					}
+					swapped[i] = 0.0;
+					mult[i] = sub / a;
+					u0[i] = a;
+					u1[i] = b;
+					u2[i] = c;
+					a = nd - mult[i] * b;
+					b = nsup - mult[i] * c;
+				} else {
+					swapped[i] = 1.0;
+					mult[i] = a / sub;
+					u0[i] = sub;
+					u1[i] = nd;
+					u2[i] = nsup;
+					a = b - mult[i] * nd;
+					b = c - mult[i] * nsup;
+				}
+				c = 0.0;
+			}
+			u0[n - 1] = (a == 0.0) ? pertol : a;
+			u1[n - 1] = 0.0;
+			u2[n - 1] = 0.0;
+			// inverse iteration from a random vector
+			double *z = Z[j];
+			for (int i = 0; i < n; i++) {
+				z[i] = rng.uniform(-1.0, 1.0);
+			}
+			for (int iter = 0; iter < 3; iter++) {
+				for (int i = 0; i < n - 1; i++) {
+					if (swapped[i] != 0.0) {
+						std::swap(z[i], z[i + 1]);
+					}
+					z[i + 1] -= mult[i] * z[i];
+				}
+				for (int i = n - 1; i >= 0; i--) {
+					double s = z[i];
+					if (i + 1 < n) {
+						s -= u1[i] * z[i + 1];
+					}
+					if (i + 2 < n) {
+						s -= u2[i] * z[i + 2];
+					}
+					z[i] = s / u0[i];
+				}
+				// orthogonalize against the cluster and normalize
+				for (int p = first; p < j; p++) {
+					double g = 0.0;
+					for (int i = 0; i < n; i++) {
+						g += Z[p][i] * z[i];
+					}
+					for (int i = 0; i < n; i++) {
+						z[i] -= g * Z[p][i];
+					}
+				}
+				double norm = 0.0;
+				for (int i = 0; i < n; i++) {
+					norm += z[i] * z[i];
+				}
+				norm = sqrt(norm);
+				for (int i = 0; i < n; i++) {
+					z[i] /= norm;
+				}
+			}
+		}
+		// transform back with the Householder vectors in the order tred2
+		// accumulates them
+		for (int i = 0; i < n - 1; i++) {
+			double h = ort[i + 1];
+			if (h == 0.0) {
+				continue;
+			}
+			for (int j = 0; j < k; j++) {
+				double g = 0.0;
+				for (int p = 0; p <= i; p++) {
+					g += V[p][i + 1] * Z[j][p];
+				}
+				g = g / h;
+				for (int p = 0; p <= i; p++) {
+					Z[j][p] -= g * V[p][i + 1];
+				}
+			}
+		}
+		for (int j = 0; j < n / 2; j++) {
+			std::swap(d[j], d[n - 1 - j]);
+		}
+		for (int j = 0; j < k; j++) {
+			for (int i = 0; i < n; i++) {
+				V[i][j] = Z[j][i];
+			}
+			e[j] = 0.0;
+		}
+	}
+
+	// Sorts the eigenpairs descending by the real part of the eigenvalues,
+	// so the largest num_components come first.
+
+	void sort_descending() {
+		for (int i = 0; i < n - 1; i++) {
+			int k = i;
+			for (int j = i + 1; j < n; j++) {
+				if (d[j] > d[k]) {
+					k = j;
+				}
+			}
+			if (k != i) {
+				std::swap(d[i], d[k]);
+				std::swap(e[i], e[k]);
+				for (int j = 0; j < n; j++) {
+					std::swap(V[j][i], V[j][k]);
+				}
+			}
+		}
+	}
+
 	// Nonsymmetric reduction from Hessenberg to real Schur form.
 
 	void hqr2() {
@@ -628,73 +1066,86 @@ private:
 		}
 	}
 
-	void compute() {
-		// allocate temporary matrices
-		V = alloc_2d<double> (n, n, 0.0);
-		d = alloc_1d<double> (n);
-		e = alloc_1d<double> (n);
-		ort = alloc_1d<double> (n);
-		// Reduce to Hessenberg form.
-		orthes();
-		// Reduce Hessenberg to real Schur form.
-		hqr2();
+	void compute(bool symmetric) {
+		// (re)allocate the workspace, a no-op for the size of the last matrix
+		V.create(n, n);
+		work.create(11, n);
+		d = work[0];
+		e = work[1];
+		ort = work[2];
+		if (symmetric) {
+			H.copyTo(V);
+			if (num_components < n) {
+				// Tridiagonalize, eigenvectors of the largest eigenvalues only.
+				tred2(false);
+				tridiagonal_eigenvectors();
+			} else {
+				// Tridiagonalize.
+				tred2(true);
+				// Diagonalize.
+				tql2(true);
+				if (descending) {
+					sort_descending();
+				}
+			}
+		} else {
+			// Reduce to Hessenberg form.
+			orthes();
+			// Reduce Hessenberg to real Schur form.
+			hqr2();
+			if (descending) {
+				sort_descending();
+			}
+		}
 	}
 
 public:
 	EigenvalueDecomposition()
-	: n(0) { }
-
-	EigenvalueDecomposition(const Mat& src) : n(src.cols) {
-		compute(src);
-	}
-
-	template <typename _Tp>
-	EigenvalueDecomposition(const Mat_<_Tp>& src) : n(src.cols){
-		compute(src);
-	}
+	: n(0), num_components(0), descending(false), d(0), e(0), ort(0) { }
 
-	void compute(const Mat& src) {
-		compute(Mat_<double>(src));
+	//! decomposes src, only the num_components largest eigenpairs if num_components > 0
+	EigenvalueDecomposition(const Mat& src, int num_components = 0)
+	: n(0), num_components(0), descending(false), d(0), e(0), ort(0) {
+		compute(src, num_components);
 	}
 
-	template<typename _Tp>
-	void compute(const Mat_<_Tp>& src) {
-		// allocate the data to work on
-		H = alloc_2d<double> (n, n);
-		// now safely copy the data
-		for (int i = 0; i < src.rows; i++) {
-			for (int j = 0; j < src.cols; j++) {
-				H[i][j] = src(i, j);
-			}
+	//! decomposes src, only the num_components largest eigenpairs if num_components > 0
+	void compute(const Mat& src, int num_components = 0) {
+		if (src.empty()) {
+			string error_message = "Empty matrix was given.";
+			CV_Error(CV_StsBadArg, error_message);
 		}
-		// finally perform the eigenvalue decomposition of H
-		compute();
-	}
-
-	~EigenvalueDecomposition() {
-		// free some memory
-		delete[] d, e, ort;
+		if (src.rows != src.cols) {
+			string error_message = format("Only square matrices can be decomposed, but size(src) = (%d,%d).", src.rows, src.cols);
+			CV_Error(CV_StsBadArg, error_message);
+		}
+		n = src.cols;
+		this->num_components = (num_components <= 0 || num_components > n) ? n : num_components;
+		descending = num_components > 0;
+		// copy the data to work on
+		src.convertTo(H, CV_64F);
+		double scale = 0.0;
 		for (int i = 0; i < n; i++) {
-			delete[] H[i];
-			delete[] V[i];
+			const double* h = H[i];
+			for (int j = 0; j < n; j++) {
+				scale = max(scale, abs(h[j]));
+			}
 		}
-		delete[] H, V;
+		// symmetric up to rounding in the computation of src
+		bool symmetric = isSymmetric(H, scale * n * DBL_EPSILON);
+		// finally perform the eigenvalue decomposition of H
+		compute(symmetric);
 	}
 
-	Mat eigenvalues() {
-		Mat eigenvalues(1, n, CV_64FC1);
-		for (int i = 0; i < n; i++) {
-			eigenvalues.at<double> (0, i) = d[i];
-		}
-		return eigenvalues;
+	//! returns the eigenvalues as 1 x num_components: ascending for a full symmetric
+	//! decomposition, descending if num_components was given, unsorted otherwise
+	Mat eigenvalues() const {
+		return work.row(0).colRange(0, num_components);
 	}
 
-	Mat eigenvectors() {
-		Mat eigenvectors(n, n, CV_64FC1);
-		for (int i = 0; i < n; i++)
-			for (int j = 0; j < n; j++)
-				eigenvectors.at<double> (i, j) = V[i][j];
-		return eigenvectors;
+	//! returns the eigenvectors by column as n x num_components, in the order of eigenvalues()
+	Mat eigenvectors() const {
+		return V.colRange(0, num_components);
 	}
 };
 
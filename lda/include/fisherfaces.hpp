@@ -19,6 +19,7 @@
 #define __FISHERFACES_HPP__
 
 #include "opencv2/opencv.hpp"
+#include "subspace.hpp"
 
 using namespace cv;
 using namespace std;
@@ -30,6 +31,15 @@ namespace subspace {
  * "Eigenfaces vs. Fisherfaces: Recognition Using Class Specific Linear Projection",
  * IEEE Transactions on Pattern Analysis and Machine Intelligence,
  * 19(7):711--720, 1997.
+ *
+ * With dtype = CV_32FC1 the PCA is computed on float data and the mean, the
+ * eigenvectors and the projections are stored as float, so samples are
+ * projected and compared in float. The LDA on the (N-C) dimensional PCA
+ * projections is small and always runs in double.
+ *
+ * The discriminants are normalized to unit length. Earlier versions used
+ * them as the nonsymmetric solver returned them, so projections, distances
+ * and thresholds are on a different scale than with those models.
  */
 class Fisherfaces {
 
@@ -37,10 +47,12 @@ private:
 
 	int _num_components;
 	double _threshold;
+	int _dtype; // CV_32FC1 or CV_64FC1, type of the mean, eigenvectors and projections
 
 	Mat _eigenvectors;
 	Mat _eigenvalues;
 	Mat _mean;
+	Projection _projection; // projects into _eigenvectors with mean*W precomputed
 
 	vector<Mat> _projections;
 	vector<int> _labels;
@@ -49,18 +61,22 @@ public:
 
 	Fisherfaces() :
 		_num_components(0),
-		_threshold(DBL_MAX) {};
+		_threshold(DBL_MAX),
+		_dtype(CV_64FC1) {};
 
-	Fisherfaces(int num_components, double threshold = DBL_MAX) :
+	Fisherfaces(int num_components, double threshold = DBL_MAX, int dtype = CV_64FC1) :
         _num_components(num_components),
-        _threshold(threshold) {};
+        _threshold(threshold),
+        _dtype(dtype) {};
 
 	Fisherfaces(const vector<Mat>& src,
 			const vector<int>& labels,
 			int num_components = 0,
-			double threshold = DBL_MAX) :
+			double threshold = DBL_MAX,
+			int dtype = CV_64FC1) :
 			    _num_components(num_components),
-			    _threshold(threshold)
+			    _threshold(threshold),
+			    _dtype(dtype)
 	{
 	    compute(src, labels);
 	}
@@ -76,6 +92,8 @@ public:
 	void predict(const Mat& src, int &label, double &confidence);
 	// project samples
 	Mat project(const Mat& src);
+	// project samples into dst, which is reused if it has the right size and type
+	void project(const Mat& src, Mat& dst);
 	// reconstruct samples
 	Mat reconstruct(const Mat& src);
 	// returns a const reference to the eigenvectors of this LDA
@@ -85,6 +103,9 @@ public:
 	// returns a const reference to the eigenvalues of this LDA
 	Mat mean() const { return _eigenvalues; }
 
+	// returns the type of the mean, eigenvectors and projections
+	int dtype() const { return _dtype; }
+
 	void setThreshold(double threshold) { _threshold = threshold; }
 	double getThreshold() const { return _threshold; }
 };
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2012. Philipp Wagner <bytefish[at]gmx[dot]de>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+#ifndef __PROJECTION_HPP__
+#define __PROJECTION_HPP__
+
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+using namespace std;
+
+namespace subspace {
+
+//! Projects samples into W as X*W - 1*(mean*W) in one GEMM, reusing its buffers between calls.
+class Projection {
+
+private:
+
+	Mat _W;
+	Mat _meanW; // 1 x K, empty without a mean
+	Mat _offsets; // meanW repeated for the largest batch so far
+	Mat _buffer; // samples converted to the type of W
+
+public:
+
+	Projection() {}
+
+	//! initialize for W and mean (which may be empty)
+	Projection(const Mat& W, const Mat& mean) {
+		init(W, mean);
+	}
+
+	//! set W and mean and precompute mean*W
+	void init(const Mat& W, const Mat& mean);
+	//! project samples into dst, which is reused if it has the right size and type
+	void project(const Mat& src, Mat& dst);
+	//! project samples
+	Mat project(const Mat& src);
+};
+
+} // namespace
+#endif
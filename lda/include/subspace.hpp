@@ -20,6 +20,7 @@
 #define __SUBSPACE_HPP__
 
 #include "opencv2/opencv.hpp"
+#include "projection.hpp"
 
 using namespace cv;
 
@@ -78,7 +79,7 @@ public:
 	Mat project(const Mat& src);
 	//! reconstruct
 	Mat reconstruct(const Mat& src);
-	//! returns the eigenvectors of this LDA
+	//! returns the eigenvectors of this LDA, normalized to unit length
 	Mat eigenvectors() const { return _eigenvectors; };
 	//! returns the eigenvalues of this LDA
 	Mat eigenvalues() const { return _eigenvalues; }
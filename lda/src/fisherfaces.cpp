@@ -28,8 +28,12 @@ void subspace::Fisherfaces::compute(const vector<Mat>& src, const vector<int>& l
         string error_message = format("Empty training data was given. You'll need more than one sample to learn a model.");
         CV_Error(CV_StsUnsupportedFormat, error_message);
     }
+    if(_dtype != CV_32FC1 && _dtype != CV_64FC1) {
+        string error_message = format("Unsupported type %d, use CV_32FC1 or CV_64FC1.", _dtype);
+        CV_Error(CV_StsBadArg, error_message);
+    }
     // wrap asRowMatrix in a try/catch, as people tend to pass wrong data here
-    Mat data = asRowMatrix(src, CV_64FC1);
+    Mat data = asRowMatrix(src, _dtype);
     // number of samples (N) and dimensions (D)
     int N = data.rows;
     int D = data.cols;
@@ -43,10 +47,10 @@ void subspace::Fisherfaces::compute(const vector<Mat>& src, const vector<int>& l
     // clip number of components to be a valid number
     if((_num_components <= 0) || (_num_components > (C-1)))
         _num_components = (C-1);
-    // perform a PCA and keep (N-C) components
+    // perform a PCA and keep (N-C) components, in the type of data
     PCA pca(data, Mat(), CV_PCA_DATA_AS_ROW, (N-C));
     // project the data and perform a LDA on it
-    subspace::LDA lda(pca.project(data), labels, _num_components);
+    subspace::LinearDiscriminantAnalysis lda(pca.project(data), labels, _num_components);
     // store the total mean vector
     _mean = pca.mean.reshape(1,1);
     // store labels
@@ -55,16 +59,22 @@ void subspace::Fisherfaces::compute(const vector<Mat>& src, const vector<int>& l
     lda.eigenvalues().convertTo(_eigenvalues, CV_64FC1);
     // Now calculate the projection matrix as pca.eigenvectors * lda.eigenvectors.
     // Note: OpenCV stores the eigenvectors by row, so we need to transpose it!
-    gemm(pca.eigenvectors, lda.eigenvectors(), 1.0, Mat(), 0.0, _eigenvectors, GEMM_1_T);
-    // store the projections of the original data
-    for(int sampleIdx = 0; sampleIdx < data.rows; sampleIdx++) {
-        Mat p = subspace::project(_eigenvectors, _mean, data.row(sampleIdx).clone());
-        _projections.push_back(p);
-    }
+    Mat ldaEigenvectors;
+    lda.eigenvectors().convertTo(ldaEigenvectors, pca.eigenvectors.type());
+    gemm(pca.eigenvectors, ldaEigenvectors, 1.0, Mat(), 0.0, _eigenvectors, GEMM_1_T);
+    _projection.init(_eigenvectors, _mean);
+    // store the projections of the original data, all in one GEMM
+    Mat projections = _projection.project(data);
+    for(int sampleIdx = 0; sampleIdx < data.rows; sampleIdx++)
+        _projections.push_back(projections.row(sampleIdx));
 }
 
 Mat subspace::Fisherfaces::project(const Mat& src) {
-	return subspace::project(_eigenvectors, _mean, src);
+	return _projection.project(src);
+}
+
+void subspace::Fisherfaces::project(const Mat& src, Mat& dst) {
+	_projection.project(src, dst);
 }
 
 Mat subspace::Fisherfaces::reconstruct(const Mat& src) {
@@ -82,7 +92,7 @@ void subspace::Fisherfaces::predict(const Mat& src, int &minClass, double &minDi
         CV_Error(CV_StsError, error_message);
     }
     // project into LDA subspace
-    Mat q = subspace::project(_eigenvectors, _mean, src.reshape(1,1));
+    Mat q = _projection.project(src.reshape(1,1));
     // find 1-nearest neighbor
     minDist = DBL_MAX;
     minClass = -1;
@@ -51,6 +51,47 @@ void read_csv(const string& filename, vector<Mat>& images, vector<int>& labels)
 	}
 }
 
+// Trains a model in double and one in float precision on all images but
+// every step-th, predicts the held out images with both and prints the
+// recognition rates and how far the results of the float model are off.
+void precision_report(const vector<Mat>& images, const vector<int>& labels, int step = 5) {
+	vector<Mat> train, test;
+	vector<int> trainLabels, testLabels;
+	for(size_t i = 0; i < images.size(); i++) {
+		if(i % step == step - 1) {
+			test.push_back(images[i]);
+			testLabels.push_back(labels[i]);
+		} else {
+			train.push_back(images[i]);
+			trainLabels.push_back(labels[i]);
+		}
+	}
+	if(test.empty() || train.empty()) {
+		cerr << "Not enough images for a precision report." << endl;
+		return;
+	}
+	subspace::Fisherfaces model64(train, trainLabels, 0, DBL_MAX, CV_64FC1);
+	subspace::Fisherfaces model32(train, trainLabels, 0, DBL_MAX, CV_32FC1);
+	int correct64 = 0, correct32 = 0, agree = 0;
+	double maxError = 0.0;
+	for(size_t i = 0; i < test.size(); i++) {
+		int label64, label32;
+		double dist64, dist32;
+		model64.predict(test[i], label64, dist64);
+		model32.predict(test[i], label32, dist32);
+		correct64 += (label64 == testLabels[i]);
+		correct32 += (label32 == testLabels[i]);
+		agree += (label64 == label32);
+		maxError = max(maxError, std::abs(dist64 - dist32) / max(dist64, DBL_MIN));
+	}
+	double rate64 = static_cast<double>(correct64) / test.size();
+	double rate32 = static_cast<double>(correct32) / test.size();
+	cout << "precision report, " << train.size() << " training and " << test.size() << " test images, " << model64.eigenvectors().cols << " components" << endl;
+	cout << "  CV_64FC1: recognition rate = " << rate64 << endl;
+	cout << "  CV_32FC1: recognition rate = " << rate32 << endl;
+	cout << "  delta = " << (rate32 - rate64) << ", same label for " << agree << "/" << test.size()
+		<< " test images, max relative distance error = " << maxError << endl;
+}
 
 int main(int argc, const char *argv[]) {
 	// Example for a Linear Discriminant Analysis
@@ -108,8 +149,9 @@ int main(int argc, const char *argv[]) {
 	vector<Mat> images;
 	vector<int> labels;
 	// check for command line arguments
-	if(argc != 2) {
-		cout << "usage: " << argv[0] << " <csv.ext>" << endl;
+	bool report = (argc == 3) && (string(argv[2]) == "--precision-report");
+	if(argc != 2 && !report) {
+		cout << "usage: " << argv[0] << " <csv.ext> [--precision-report]" << endl;
 		exit(1);
 	}
 	// path to your CSV
@@ -121,6 +163,11 @@ int main(int argc, const char *argv[]) {
 		cerr << "Error opening file \"" << fn_csv << "\"." << endl;
 		exit(1);
 	}
+	// compare float to double precision instead of the demo
+	if(report) {
+		precision_report(images, labels);
+		return 0;
+	}
 	// get width and height
 	int width = images[0].cols;
 	int height = images[0].rows;
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2011. Philipp Wagner <bytefish[at]gmx[dot]de>.
+ * Released to public domain under terms of the BSD Simplified license.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the organization nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *   See <http://www.opensource.org/licenses/bsd-license>
+ */
+#include "projection.hpp"
+
+void subspace::Projection::init(const Mat& W, const Mat& mean) {
+    // make sure mean is correct if not empty
+    if(!mean.empty() && (mean.total() != W.rows)) {
+        string error_message = format("Wrong mean shape for the given projection matrix. Expected %d, but was %d.", W.rows, mean.total());
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    _W = W;
+    _meanW.release();
+    _offsets.release();
+    if(!mean.empty()) {
+        Mat m;
+        mean.reshape(1,1).convertTo(m, W.type());
+        gemm(m, W, 1.0, Mat(), 0.0, _meanW);
+    }
+}
+
+//! computes Y = X*W - 1*(mean*W)
+void subspace::Projection::project(const Mat& src, Mat& dst) {
+    // get number of samples and dimension
+    int n = src.rows;
+    int d = src.cols;
+    // make sure the data has the correct shape
+    if(_W.rows != d) {
+        string error_message = format("Wrong shapes for given matrices. Was size(src) = (%d,%d), size(W) = (%d,%d).", src.rows, src.cols, _W.rows, _W.cols);
+        CV_Error(CV_StsBadArg, error_message);
+    }
+    // make sure you operate on correct type
+    const Mat* X = &src;
+    if(src.type() != _W.type()) {
+        src.convertTo(_buffer, _W.type());
+        X = &_buffer;
+    }
+    if(_meanW.empty()) {
+        gemm(*X, _W, 1.0, Mat(), 0.0, dst);
+        return;
+    }
+    // grow the offsets to the batch
+    if(_offsets.rows < n)
+        repeat(_meanW, n, 1, _offsets);
+    // finally calculate projection as Y = X*W - 1*(mean*W)
+    gemm(*X, _W, 1.0, _offsets.rowRange(0, n), -1.0, dst);
+}
+
+Mat subspace::Projection::project(const Mat& src) {
+    Mat dst;
+    project(src, dst);
+    return dst;
+}
@@ -24,34 +24,8 @@ using namespace cv;
 
 //! computes Y = (X-mean)*W
 Mat subspace::project(const Mat& W, const Mat& mean, const Mat& src) {
-    // get number of samples and dimension
-    int n = src.rows;
-    int d = src.cols;
-    // make sure the data has the correct shape
-    if(W.rows != d) {
-        string error_message = format("Wrong shapes for given matrices. Was size(src) = (%d,%d), size(W) = (%d,%d).", src.rows, src.cols, W.rows, W.cols);
-        CV_Error(CV_StsBadArg, error_message);
-    }
-    // make sure mean is correct if not empty
-    if(!mean.empty() && (mean.total() != d)) {
-        string error_message = format("Wrong mean shape for the given data matrix. Expected %d, but was %d.", d, mean.total());
-        CV_Error(CV_StsBadArg, error_message);
-    }
-    // create temporary matrices
-    Mat X, Y;
-    // make sure you operate on correct type
-    src.convertTo(X, W.type());
-    // safe to do, because of above assertion
-    // safe to do, because of above assertion
-    if(!mean.empty()) {
-        for(int i=0; i<n; i++) {
-            Mat r_i = X.row(i);
-            subtract(r_i, mean.reshape(1,1), r_i);
-        }
-    }
-    // finally calculate projection as Y = (X-mean)*W
-    gemm(X, W, 1.0, Mat(), 0.0, Y);
-    return Y;
+    Projection projection(W, mean);
+    return projection.project(src);
 }
 
 //! X = Y*W'+mean
@@ -154,32 +128,43 @@ void subspace::LinearDiscriminantAnalysis::compute(const Mat& src, const vector<
     // calculate within-classes scatter
     Mat Sw = Mat::zeros(D, D, data.type());
     mulTransposed(data, Sw, true);
-    // calculate between-classes scatter
-    Mat Sb = Mat::zeros(D, D, data.type());
+    // the between-classes scatter is Sb = Mb^T*Mb with the centered class
+    // means as rows of Mb
+    Mat Mb(C, D, data.type());
     for (int i = 0; i < C; i++) {
-        Mat tmp;
-        subtract(meanClass[i], meanTotal, tmp);
-        mulTransposed(tmp, tmp, true);
-        add(Sb, tmp, Sb);
+        Mat r_i = Mb.row(i);
+        subtract(meanClass[i], meanTotal, r_i);
     }
-    // invert Sw
-    Mat Swi = Sw.inv();
-    // M = inv(Sw)*Sb
-    Mat M;
-    gemm(Swi, Sb, 1.0, Mat(), 0.0, M);
-    EigenvalueDecomposition es(M);
+    // The eigenvectors of inv(Sw)*Sb are w = T*y for the eigenvectors y of
+    // the symmetric matrix T^T*Sb*T with T = U*L^(-1/2) from Sw = U*L*U^T,
+    // so both decompositions take the symmetric path and only the
+    // num_components discriminants are computed. Directions without
+    // within-class variance can't be whitened and are left out.
+    EigenvalueDecomposition esw(Sw);
+    Mat L = esw.eigenvalues();
+    Mat U = esw.eigenvectors();
+    double maxL = L.at<double>(D - 1); // eigenvalues are ascending
+    int first = 0;
+    while (first < D && L.at<double>(first) <= maxL * D * DBL_EPSILON)
+        first++;
+    Mat T(D, D - first, data.type());
+    for (int j = first; j < D; j++) {
+        Mat t = T.col(j - first);
+        Mat u = U.col(j) * (1.0 / sqrt(L.at<double>(j)));
+        u.copyTo(t);
+    }
+    Mat B, A;
+    gemm(Mb, T, 1.0, Mat(), 0.0, B);
+    mulTransposed(B, A, true);
+    // the num_components largest eigenpairs, in descending order
+    EigenvalueDecomposition es(A, _num_components);
     _eigenvalues = es.eigenvalues();
-    _eigenvectors = es.eigenvectors();
-    // reshape eigenvalues, so they are stored by column
-    _eigenvalues = _eigenvalues.reshape(1, 1);
-    // get sorted indices descending by their eigenvalue
-    vector<int> sorted_indices = argsort(_eigenvalues, false);
-    // now sort eigenvalues and eigenvectors accordingly
-    _eigenvalues = sortMatrixColumnsByIndices(_eigenvalues, sorted_indices);
-    _eigenvectors = sortMatrixColumnsByIndices(_eigenvectors, sorted_indices);
-    // and now take only the num_components and we're out!
-    _eigenvalues = Mat(_eigenvalues, Range::all(), Range(0, _num_components));
-    _eigenvectors = Mat(_eigenvectors, Range::all(), Range(0, _num_components));
+    gemm(T, es.eigenvectors(), 1.0, Mat(), 0.0, _eigenvectors);
+    // the eigenvectors of inv(Sw)*Sb are only defined up to scale
+    for (int j = 0; j < _eigenvectors.cols; j++) {
+        Mat w = _eigenvectors.col(j);
+        normalize(w, w);
+    }
 }
 
 Mat subspace::LinearDiscriminantAnalysis::project(const Mat& src) {
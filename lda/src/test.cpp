@@ -0,0 +1,236 @@
+// Regression tests for the eigenvalue decomposition and the discriminant
+// analysis on synthetic matrices. Prints every failed check and returns the
+// number of failures:
+//
+//   lda_test
+
+#include "opencv2/opencv.hpp"
+
+#include <cstdio>
+#include <vector>
+
+#include "decomposition.hpp"
+#include "subspace.hpp"
+
+using namespace std;
+using namespace cv;
+
+static int failures = 0;
+
+static void check(bool condition, const char* name) {
+    if(!condition) {
+        printf("FAILED: %s\n", name);
+        failures++;
+    }
+}
+
+// largest absolute element
+static double max_abs(const Mat& src) {
+    Mat m;
+    src.convertTo(m, CV_64F);
+    double result = 0.0;
+    for(int i = 0; i < m.rows; i++)
+        for(int j = 0; j < m.cols; j++)
+            result = max(result, abs(m.at<double>(i, j)));
+    return result;
+}
+
+static Mat random_symmetric(int n, int seed) {
+    RNG rng(seed);
+    Mat B(n, n, CV_64FC1);
+    for(int i = 0; i < n; i++)
+        for(int j = 0; j < n; j++)
+            B.at<double>(i, j) = rng.uniform(-1.0, 1.0);
+    Mat A = B + B.t();
+    return A;
+}
+
+// Q*diag(d)*Q^T with Q the product of two Householder reflections, so the
+// eigenvalues are exactly the ones in d, repeated ones included
+static Mat with_eigenvalues(const vector<double>& d, int seed) {
+    int n = static_cast<int>(d.size());
+    RNG rng(seed);
+    Mat Q = Mat::eye(n, n, CV_64FC1);
+    for(int k = 0; k < 2; k++) {
+        Mat u(n, 1, CV_64FC1);
+        for(int i = 0; i < n; i++)
+            u.at<double>(i) = rng.uniform(-1.0, 1.0);
+        Mat H = Mat::eye(n, n, CV_64FC1) - u * u.t() * (2.0 / u.dot(u));
+        Q = H * Q;
+    }
+    Mat D = Mat::zeros(n, n, CV_64FC1);
+    for(int i = 0; i < n; i++)
+        D.at<double>(i, i) = d[i];
+    Mat A = Q * D * Q.t();
+    // symmetric to the last bit
+    Mat S = (A + A.t()) * 0.5;
+    return S;
+}
+
+// true if A*v = lambda*v for every pair, relative to the largest element of A
+static bool eigenpairs(const Mat& A, const Mat& L, const Mat& V, double tolerance) {
+    Mat R = A * V;
+    for(int j = 0; j < V.cols; j++) {
+        Mat r = R.col(j) - V.col(j) * L.at<double>(j);
+        if(max_abs(r) > tolerance * max_abs(A))
+            return false;
+    }
+    return true;
+}
+
+// true if the columns of V are orthonormal
+static bool orthonormal(const Mat& V, double tolerance) {
+    Mat G = V.t() * V - Mat::eye(V.cols, V.cols, CV_64FC1);
+    return max_abs(G) <= tolerance;
+}
+
+static bool ascending(const Mat& L) {
+    for(int j = 1; j < L.cols; j++)
+        if(L.at<double>(j) < L.at<double>(j - 1))
+            return false;
+    return true;
+}
+
+static bool descending(const Mat& L) {
+    for(int j = 1; j < L.cols; j++)
+        if(L.at<double>(j) > L.at<double>(j - 1))
+            return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// tests
+//------------------------------------------------------------------------------
+
+// The full symmetric path (tred2, tql2) and the top-k path (tql2 without
+// vectors, inverse iteration, back-transform) on a random symmetric matrix,
+// against cv::eigen, which returns the eigenvalues in descending order.
+static void test_symmetric() {
+    const int n = 40, k = 6;
+    Mat A = random_symmetric(n, 1);
+    Mat expected, unused;
+    eigen(A, true, expected, unused);
+    EigenvalueDecomposition full(A);
+    Mat L = full.eigenvalues(), V = full.eigenvectors();
+    check(L.cols == n && ascending(L), "symmetric eigenvalues are ascending");
+    bool same = true;
+    for(int j = 0; j < n; j++)
+        same = same && abs(L.at<double>(j) - expected.at<double>(n - 1 - j)) <= 1e-10;
+    check(same, "symmetric eigenvalues match cv::eigen");
+    check(eigenpairs(A, L, V, 1e-12), "symmetric residual");
+    check(orthonormal(V, 1e-12), "symmetric eigenvectors are orthonormal");
+    EigenvalueDecomposition top(A, k);
+    L = top.eigenvalues(), V = top.eigenvectors();
+    check(L.cols == k && V.cols == k && descending(L), "top-k eigenvalues are descending");
+    same = true;
+    for(int j = 0; j < k; j++)
+        same = same && abs(L.at<double>(j) - expected.at<double>(j)) <= 1e-10;
+    check(same, "top-k eigenvalues match cv::eigen");
+    check(eigenpairs(A, L, V, 1e-12), "top-k residual");
+    check(orthonormal(V, 1e-12), "top-k eigenvectors are orthonormal");
+}
+
+// Clusters of equal eigenvalues: inverse iteration must orthogonalize the
+// vectors within a cluster, also when the top k end inside one.
+static void test_repeated_eigenvalues() {
+    const double values[] = { 5, 5, 5, 2, 2, 1, 0.5, -1, -1, -3, -3, -3, 0, 0, 0, 0, 7, 4, 4, 6 };
+    vector<double> d(values, values + 20);
+    Mat A = with_eigenvalues(d, 2);
+    EigenvalueDecomposition full(A);
+    check(eigenpairs(A, full.eigenvalues(), full.eigenvectors(), 1e-12), "repeated eigenvalues, residual");
+    check(orthonormal(full.eigenvectors(), 1e-12), "repeated eigenvalues, orthonormal");
+    const int ks[] = { 3, 4, 6, 20 };
+    for(int i = 0; i < 4; i++) {
+        EigenvalueDecomposition top(A, ks[i]);
+        Mat L = top.eigenvalues(), V = top.eigenvectors();
+        // 7, 6, 5, 5, 5, 4, ...
+        bool same = true;
+        for(int j = 0; j < ks[i]; j++)
+            same = same && abs(L.at<double>(j) - full.eigenvalues().at<double>(19 - j)) <= 1e-12;
+        check(same && descending(L), "repeated eigenvalues, top-k values");
+        check(eigenpairs(A, L, V, 1e-12), "repeated eigenvalues, top-k residual");
+        check(orthonormal(V, 1e-12), "repeated eigenvalues, top-k orthonormal");
+    }
+}
+
+// An upper triangular matrix takes the nonsymmetric path, its eigenvalues
+// are the diagonal.
+static void test_nonsymmetric() {
+    const int n = 12;
+    RNG rng(3);
+    Mat A = Mat::zeros(n, n, CV_64FC1);
+    for(int i = 0; i < n; i++) {
+        A.at<double>(i, i) = i + 1;
+        for(int j = i + 1; j < n; j++)
+            A.at<double>(i, j) = rng.uniform(-1.0, 1.0);
+    }
+    EigenvalueDecomposition full(A);
+    Mat L = full.eigenvalues(), V = full.eigenvectors();
+    vector<double> sorted;
+    for(int j = 0; j < n; j++)
+        sorted.push_back(L.at<double>(j));
+    std::sort(sorted.begin(), sorted.end());
+    bool same = true;
+    for(int j = 0; j < n; j++)
+        same = same && abs(sorted[j] - (j + 1)) <= 1e-10;
+    check(same, "nonsymmetric eigenvalues are the diagonal");
+    check(eigenpairs(A, L, V, 1e-10), "nonsymmetric residual");
+    EigenvalueDecomposition top(A, 3);
+    L = top.eigenvalues();
+    check(L.cols == 3 && abs(L.at<double>(0) - n) <= 1e-10 && abs(L.at<double>(2) - (n - 2)) <= 1e-10, "nonsymmetric top-k eigenvalues");
+    check(eigenpairs(A, L, top.eigenvectors(), 1e-10), "nonsymmetric top-k residual");
+}
+
+// The discriminants have unit length and solve Sb*w = lambda*Sw*w, with the
+// scatter matrices computed like the LDA does.
+static void test_discriminants() {
+    const int N = 90, D = 6, C = 3;
+    RNG rng(4);
+    Mat data(N, D, CV_64FC1);
+    vector<int> labels;
+    for(int i = 0; i < N; i++) {
+        int c = i % C;
+        for(int j = 0; j < D; j++)
+            data.at<double>(i, j) = rng.uniform(-1.0, 1.0) + (j == c ? 3.0 : 0.0);
+        labels.push_back(c);
+    }
+    subspace::LinearDiscriminantAnalysis lda(data, labels);
+    Mat W = lda.eigenvectors(), L = lda.eigenvalues();
+    check(W.cols == C - 1 && descending(L), "LDA returns C-1 discriminants");
+    bool unit = true;
+    for(int j = 0; j < W.cols; j++)
+        unit = unit && abs(norm(W.col(j)) - 1.0) <= 1e-12;
+    check(unit, "LDA discriminants have unit length");
+    Mat mean = Mat::zeros(1, D, CV_64FC1);
+    vector<Mat> means(C);
+    for(int c = 0; c < C; c++)
+        means[c] = Mat::zeros(1, D, CV_64FC1);
+    for(int i = 0; i < N; i++) {
+        mean += data.row(i) / N;
+        means[labels[i]] += data.row(i) / (N / C);
+    }
+    Mat Sw = Mat::zeros(D, D, CV_64FC1), Sb = Mat::zeros(D, D, CV_64FC1);
+    for(int i = 0; i < N; i++) {
+        Mat x = data.row(i) - means[labels[i]];
+        Sw += x.t() * x;
+    }
+    for(int c = 0; c < C; c++) {
+        Mat m = means[c] - mean;
+        Sb += m.t() * m;
+    }
+    bool solved = true;
+    for(int j = 0; j < W.cols; j++) {
+        Mat r = Sb * W.col(j) - Sw * W.col(j) * L.at<double>(j);
+        solved = solved && max_abs(r) <= 1e-10 * max_abs(Sb);
+    }
+    check(solved, "LDA discriminants solve Sb*w = lambda*Sw*w");
+}
+
+int main() {
+    test_symmetric();
+    test_repeated_eigenvalues();
+    test_nonsymmetric();
+    test_discriminants();
+    printf("%d failure(s)\n", failures);
+    return failures;
+}